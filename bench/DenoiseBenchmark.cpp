@@ -0,0 +1,167 @@
+// Quality and cost of the TemporalDenoiser for several strengths.
+//
+// Without arguments a synthetic sequence is used: a static gradient with a
+// textured square moving across it, plus gaussian noise like the sensor at
+// full gain. PSNR against the clean sequence is reported separately for the
+// static background and the moving square, the latter shows smearing.
+// With a recording (see FrameRecorder) its frames are filtered instead; there
+// is no clean reference then, the mean frame to frame difference shows how
+// much flicker is left.
+//
+//   ./webcam_denoise_bench [recording]
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "../src/TemporalDenoiser.hpp"
+#include "../src/FrameReplay.hpp"
+
+using namespace std::chrono;
+
+namespace {
+
+const cv::Size frameSize(752, 400);
+const int strengths[] = {0, 40, 60, 80, 90};
+
+struct Sequence {
+    std::vector<cv::Mat> noisy;
+    std::vector<cv::Mat> clean;
+    std::vector<cv::Rect> moving;
+};
+
+Sequence makeSequence(int frames) {
+    Sequence sequence;
+    cv::Mat background(frameSize, CV_8UC4);
+    for (int y = 0; y < background.rows; y++)
+    {
+        for (int x = 0; x < background.cols; x++)
+        {
+            const auto value = static_cast<uint8_t>(40 + (x * 120) / background.cols + (y * 40) / background.rows);
+            background.at<cv::Vec4b>(y, x) = cv::Vec4b(value, value, static_cast<uint8_t>(value + 20), 255);
+        }
+    }
+    cv::Mat texture(96, 96, CV_8UC4);
+    cv::randu(texture, cv::Scalar::all(0), cv::Scalar::all(255));
+    cv::GaussianBlur(texture, texture, cv::Size(), 2);
+
+    cv::RNG rng(1);
+    for (int i = 0; i < frames; i++)
+    {
+        cv::Mat clean = background.clone();
+        const cv::Rect square((i * 6) % (frameSize.width - texture.cols), 150, texture.cols, texture.rows);
+        texture.copyTo(clean(square));
+        cv::Mat noise(frameSize, CV_16SC4);
+        rng.fill(noise, cv::RNG::NORMAL, 0, 8);
+        cv::Mat noisy;
+        cv::add(clean, noise, noisy, cv::noArray(), CV_8U);
+        sequence.clean.push_back(clean);
+        sequence.noisy.push_back(noisy);
+        sequence.moving.push_back(square);
+    }
+    return sequence;
+}
+
+// runs the whole sequence through a denoiser, returns ms per frame
+double run(webcam::TemporalDenoiser &denoiser, const std::vector<cv::Mat> &frames,
+           const std::function<void(size_t, const cv::Mat &)> &result) {
+    double total_ms = 0;
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        const auto start = steady_clock::now();
+        cv::Mat &out = denoiser.beginFrame();
+        denoiser.filterRows(frames[i], 0, frames[i].rows);
+        total_ms += duration<double, std::milli>(steady_clock::now() - start).count();
+        result(i, out);
+    }
+    return total_ms / frames.size();
+}
+
+void synthetic() {
+    const Sequence sequence = makeSequence(120);
+    std::cout << "strength   ms/frame   PSNR static   PSNR moving" << std::endl;
+    for (int strength : strengths)
+    {
+        webcam::TemporalDenoiser denoiser(frameSize, strength);
+        double staticPsnr = 0;
+        double movingPsnr = 0;
+        int measured = 0;
+        const double ms = run(denoiser, sequence.noisy, [&](size_t i, const cv::Mat &out) {
+            // give the filter time to settle
+            if (i < 20)
+            {
+                return;
+            }
+            const cv::Rect square = sequence.moving[i];
+            const cv::Rect staticArea(0, 0, frameSize.width, square.y);
+            staticPsnr += cv::PSNR(out(staticArea), sequence.clean[i](staticArea));
+            movingPsnr += cv::PSNR(out(square), sequence.clean[i](square));
+            measured++;
+        });
+        std::cout << std::setw(8) << strength << std::fixed << std::setprecision(2) << std::setw(11) << ms
+                  << std::setw(14) << staticPsnr / measured << std::setw(14) << movingPsnr / measured << std::endl;
+    }
+}
+
+void recording(const std::string &file) {
+    webcam::FrameReplay replay(file);
+    std::vector<cv::Mat> frames;
+    for (size_t i = 0; i < replay.frameCount(); i++)
+    {
+        const webcam::RawFrame frame = replay.frame(i);
+        if (frame.width < frameSize.width || frame.height < frameSize.height)
+        {
+            continue;
+        }
+        cv::Mat raw(frame.height, frame.width, CV_8UC(frame.channelCount), frame.data);
+        cv::Mat bgra;
+        const webcam::SensorFormat format = webcam::sensorFormatFor(frame.channelCount);
+        cv::cvtColor(raw, bgra, format == webcam::SensorFormat::Mono8 ? cv::COLOR_GRAY2BGRA
+                                : format == webcam::SensorFormat::YUV422 ? cv::COLOR_YUV2BGRA_YUYV
+                                : cv::COLOR_RGB2BGRA);
+        // the middle of the frame, where the pipeline would filter
+        frames.push_back(bgra(cv::Rect(cv::Point((frame.width - frameSize.width) / 2,
+                                                 (frame.height - frameSize.height) / 2), frameSize)).clone());
+    }
+    if (frames.size() < 2)
+    {
+        std::cout << file << " has no frames of at least " << frameSize << std::endl;
+        return;
+    }
+
+    std::cout << frames.size() << " frames of " << replay.serial() << std::endl;
+    std::cout << "strength   ms/frame   frame difference" << std::endl;
+    for (int strength : strengths)
+    {
+        webcam::TemporalDenoiser denoiser(frameSize, strength);
+        cv::Mat previous;
+        double difference = 0;
+        const double ms = run(denoiser, frames, [&](size_t i, const cv::Mat &out) {
+            if (i > 0)
+            {
+                difference += cv::norm(out, previous, cv::NORM_L1) / static_cast<double>(out.total() * 4);
+            }
+            out.copyTo(previous);
+        });
+        std::cout << std::setw(8) << strength << std::fixed << std::setprecision(2) << std::setw(11) << ms
+                  << std::setw(19) << difference / (frames.size() - 1) << std::endl;
+    }
+}
+
+}
+
+int main(int argc, char **argv) {
+    cv::setNumThreads(1);
+    if (argc > 1)
+    {
+        recording(argv[1]);
+    }
+    else
+    {
+        synthetic();
+    }
+    return 0;
+}
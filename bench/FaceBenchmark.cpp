@@ -0,0 +1,95 @@
+// Cost of a face detection run and of the framing as the number of faces in
+// the picture grows. The face found in a sample image (OpenCV's lena.jpg or the
+// image passed as argument) is pasted 0 to 6 times into a frame of the size the
+// pipeline detects on, then each frame is detected on repeatedly.
+//
+//   ./webcam_face_bench [image with a face] [runs per count]
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "../src/FaceDetector.hpp"
+#include "../src/FaceFraming.hpp"
+
+using namespace std::chrono;
+
+namespace {
+
+constexpr int maxFaces = 6;
+// undistorted region the pipeline detects on
+const cv::Size frameSize(752, 400);
+
+}
+
+int main(int argc, char **argv) {
+    const std::string imageFile = argc > 1 ? argv[1] : cv::samples::findFile("lena.jpg");
+    const int runs = argc > 2 ? std::stoi(argv[2]) : 20;
+    const cv::Mat image = cv::imread(imageFile);
+    if (image.empty() || runs <= 0)
+    {
+        std::cout << "usage: " << argv[0] << " [image with a face] [runs per count]" << std::endl;
+        return 1;
+    }
+
+    cv::setNumThreads(1);
+    webcam::FaceDetector detector;
+    while (!detector.ready())
+    {
+        std::this_thread::sleep_for(milliseconds(10));
+    }
+
+    cv::Mat bgra;
+    cv::cvtColor(image, bgra, cv::COLOR_BGR2BGRA);
+    const auto found = detector.detectFaces(bgra);
+    if (found.empty())
+    {
+        std::cout << "No face in " << imageFile << std::endl;
+        return 1;
+    }
+    // the face with some room around it, scaled so six fit next to each other in two rows
+    const cv::Rect box = found.front().box;
+    const cv::Rect patchRegion = cv::Rect(box.x - box.width / 4, box.y - box.height / 4, box.width * 3 / 2,
+                                          box.height * 3 / 2) & cv::Rect(0, 0, bgra.cols, bgra.rows);
+    cv::Mat patch;
+    const int side = frameSize.height / 2 - 8;
+    cv::resize(bgra(patchRegion), patch, cv::Size(side, side));
+
+    std::cout << "faces   found   confidence   detect ms   framing us" << std::endl;
+    for (int count = 0; count <= maxFaces; count++)
+    {
+        cv::Mat frame(frameSize, CV_8UC4);
+        cv::randn(frame, cv::Scalar(90, 100, 110, 255), cv::Scalar(8, 8, 8, 0));
+        for (int i = 0; i < count; i++)
+        {
+            const cv::Point at((i % 3) * frameSize.width / 3 + 4, (i / 3) * frameSize.height / 2 + 4);
+            patch.copyTo(frame(cv::Rect(at, patch.size())));
+        }
+
+        webcam::FaceFraming framing(frameSize, 250);
+        std::vector<webcam::Face> faces;
+        double detect_ms = 0;
+        double framing_us = 0;
+        for (int run = 0; run < runs; run++)
+        {
+            const auto start = steady_clock::now();
+            faces = detector.detectFaces(frame);
+            const auto detected = steady_clock::now();
+            framing.update(faces);
+            framing.step();
+            detect_ms += duration<double, std::milli>(detected - start).count();
+            framing_us += duration<double, std::micro>(steady_clock::now() - detected).count();
+        }
+        double confidence = 0;
+        for (const auto &face : faces)
+        {
+            confidence += face.confidence / faces.size();
+        }
+        std::cout << std::setw(5) << count << std::setw(8) << faces.size() << std::fixed << std::setprecision(2)
+                  << std::setw(13) << confidence << std::setw(12) << detect_ms / runs
+                  << std::setw(13) << framing_us / runs << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,135 @@
+// Wake-up latency and processing time of a frame loop paced like a 30 fps camera
+// while other threads keep every CPU busy allocating and touching memory. The
+// first run uses the default scheduling, the second SCHED_FIFO for the loop and
+// the pool workers, locked memory and huge page frame buffers (see Realtime.hpp).
+// Without the privileges for these the second run warns about what it couldn't
+// apply and measures the rest.
+//
+//   ./webcam_jitter_bench [seconds per run] [priority]
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <time.h>
+#include <opencv2/opencv.hpp>
+#include "../src/FramePipeline.hpp"
+#include "../src/Realtime.hpp"
+#include "../src/ThreadPool.hpp"
+#include "../src/Undistortion.hpp"
+
+namespace {
+
+constexpr long framePeriod_ns = 1'000'000'000 / 30;
+// pipeline buffers are allocated and the face detector loads during the first frames
+constexpr int warmupFrames = 30;
+
+double elapsed_us(const timespec &from, const timespec &to) {
+    return (to.tv_sec - from.tv_sec) * 1e6 + (to.tv_nsec - from.tv_nsec) / 1e3;
+}
+
+double percentile(std::vector<double> values, double fraction) {
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, static_cast<size_t>(fraction * values.size()))];
+}
+
+void run(const char *name, int seconds, const webcam::ThreadScheduling &scheduling, const webcam::RawFrame &frame) {
+    webcam::ThreadPool pool(std::max(std::thread::hardware_concurrency(), 1u), scheduling);
+    pool.runOpenCvLoops();
+    webcam::OutputConfig output;
+    auto pipeline = webcam::FramePipeline::create(webcam::SensorFormat::BGR888, {output}, pool, 32);
+
+    // memory churn and busy CPUs, at default priority
+    std::atomic<bool> loadShouldRun{true};
+    std::vector<std::thread> load;
+    for (unsigned int i = 0; i < std::max(std::thread::hardware_concurrency(), 1u); i++)
+    {
+        load.emplace_back([&loadShouldRun] {
+            unsigned long sum = 0;
+            while (loadShouldRun)
+            {
+                std::vector<unsigned char> buffer(4 << 20, 1);
+                for (size_t j = 0; j < buffer.size(); j += 64)
+                {
+                    sum += buffer[j];
+                }
+            }
+            volatile unsigned long keep = sum;
+            (void)keep;
+        });
+    }
+
+    std::vector<double> lateness_us;
+    std::vector<double> processing_us;
+    timespec next{};
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (int i = 0; i < warmupFrames + seconds * 30; i++)
+    {
+        next.tv_nsec += framePeriod_ns;
+        if (next.tv_nsec >= 1'000'000'000)
+        {
+            next.tv_nsec -= 1'000'000'000;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr);
+        timespec woken{};
+        clock_gettime(CLOCK_MONOTONIC, &woken);
+        pipeline->process(frame);
+        timespec done{};
+        clock_gettime(CLOCK_MONOTONIC, &done);
+        if (i >= warmupFrames)
+        {
+            lateness_us.push_back(elapsed_us(next, woken));
+            processing_us.push_back(elapsed_us(woken, done));
+        }
+    }
+
+    loadShouldRun = false;
+    for (auto &thread : load)
+    {
+        thread.join();
+    }
+
+    std::cout << std::left << std::setw(10) << name << std::right << std::fixed << std::setprecision(0);
+    for (const auto *values : {&lateness_us, &processing_us})
+    {
+        std::cout << std::setw(9) << percentile(*values, 0.5) << std::setw(9) << percentile(*values, 0.99)
+                  << std::setw(9) << percentile(*values, 1.0);
+    }
+    std::cout << std::endl;
+}
+
+}
+
+int main(int argc, char **argv) {
+    const int seconds = argc > 1 ? std::stoi(argv[1]) : 10;
+    const int priority = argc > 2 ? std::stoi(argv[2]) : 50;
+    if (seconds <= 0)
+    {
+        std::cout << "usage: " << argv[0] << " [seconds per run] [priority]" << std::endl;
+        return 1;
+    }
+
+    cv::Mat frame(webcam::Undistortion::cameraHeight, webcam::Undistortion::cameraWidth, CV_8UC3);
+    cv::randu(frame, cv::Scalar::all(0), cv::Scalar::all(255));
+    webcam::RawFrame rawFrame;
+    rawFrame.width = frame.cols;
+    rawFrame.height = frame.rows;
+    rawFrame.channelCount = frame.channels();
+    rawFrame.data = frame.data;
+
+    std::cout << "all in us   wake-up late (p50, p99, max)  processing (p50, p99, max)" << std::endl;
+    run("default", seconds, {}, rawFrame);
+
+    webcam::ThreadScheduling realtime;
+    realtime.policy = webcam::ThreadScheduling::Policy::FIFO;
+    realtime.priority = priority;
+    webcam::applyScheduling(realtime, "benchmark loop");
+    webcam::useHugePageBuffers();
+    webcam::lockMemory();
+    run("realtime", seconds, realtime, rawFrame);
+    return 0;
+}
@@ -0,0 +1,174 @@
+// Measures the per-frame latency of FramePipeline for every thread count
+// from 1 to the number of cores, separately for the frames that search for
+// faces, the gain of feeding it only the sensor
+// AOI it needs, the cost of a second, simulcast output, the pipeline
+// variant of every sensor format and of a color transform while packing.
+// Needs no camera and no loopback device.
+//
+//   ./webcam_bench [bandRows] [frames]
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "../src/ColorTransform.hpp"
+#include "../src/FramePipeline.hpp"
+#include "../src/SyntheticCamera.hpp"
+#include "../src/ThreadPool.hpp"
+#include "../src/Undistortion.hpp"
+
+using namespace std::chrono;
+
+namespace {
+
+// latencies of all frames, those that ran the face detection also go to detectionFrames if given
+std::vector<double> measure(webcam::FramePipeline &pipeline, const webcam::RawFrame &frame, int frames,
+                            std::vector<double> *detectionFrames = nullptr) {
+    // warm up, lets the buffers get allocated and the face detector load
+    for (int i = 0; i < 10 || (!pipeline.faceDetectionReady() && i < 500); i++)
+    {
+        pipeline.process(frame);
+    }
+
+    std::vector<double> latencies;
+    for (int i = 0; i < frames; i++)
+    {
+        const auto start = steady_clock::now();
+        pipeline.process(frame);
+        latencies.push_back(duration<double, std::milli>(steady_clock::now() - start).count());
+        // the frame doesn't change, so these are only the searches forced every 30 frames
+        if (detectionFrames != nullptr && pipeline.stageTimes().detect_ms > 0)
+        {
+            detectionFrames->push_back(latencies.back());
+        }
+    }
+    std::sort(latencies.begin(), latencies.end());
+    if (detectionFrames != nullptr)
+    {
+        std::sort(detectionFrames->begin(), detectionFrames->end());
+    }
+    return latencies;
+}
+
+void printLatency(const std::string &label, const std::vector<double> &latencies) {
+    if (latencies.empty())
+    {
+        std::cout << std::setw(7) << label << "         -           -        -" << std::endl;
+        return;
+    }
+    double sum = 0;
+    for (double l : latencies)
+    {
+        sum += l;
+    }
+    std::cout << std::setw(7) << label << std::fixed << std::setprecision(2)
+              << std::setw(10) << sum / latencies.size()
+              << std::setw(12) << latencies[latencies.size() / 2]
+              << std::setw(9) << latencies[latencies.size() * 95 / 100] << std::endl;
+}
+
+}
+
+int main(int argc, char **argv) {
+    const int bandRows = argc > 1 ? std::stoi(argv[1]) : 32;
+    const int frames = argc > 2 ? std::stoi(argv[2]) : 200;
+    const unsigned int maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    cv::Mat frame = webcam::renderTestImage(webcam::Undistortion::cameraWidth, webcam::Undistortion::cameraHeight,
+                                            webcam::SensorFormat::BGR888);
+    webcam::RawFrame rawFrame;
+    rawFrame.width = frame.cols;
+    rawFrame.height = frame.rows;
+    rawFrame.channelCount = frame.channels();
+    rawFrame.data = frame.data;
+
+    std::cout << "band rows: " << bandRows << ", frames: " << frames << std::endl;
+    std::cout << "threads   mean ms   median ms   p95 ms" << std::endl;
+    std::vector<std::vector<double>> detectionFrames(maxThreads);
+    for (unsigned int threads = 1; threads <= maxThreads; threads++)
+    {
+        webcam::ThreadPool pool(threads);
+        // the face detection runs on the pool as well, as in the app
+        pool.runOpenCvLoops();
+        auto pipeline = webcam::FramePipeline::create(webcam::SensorFormat::BGR888, {webcam::OutputConfig()}, pool,
+                                                      bandRows);
+        printLatency(std::to_string(threads), measure(*pipeline, rawFrame, frames, &detectionFrames[threads - 1]));
+    }
+
+    // the frames that searched for faces, the slowest ones
+    std::cout << std::endl << "with face detection" << std::endl;
+    std::cout << "threads   mean ms   median ms   p95 ms" << std::endl;
+    for (unsigned int threads = 1; threads <= maxThreads; threads++)
+    {
+        printLatency(std::to_string(threads), detectionFrames[threads - 1]);
+    }
+
+    // the same on a single thread, once with the full sensor and once with the AOI the camera gets programmed with
+    webcam::ThreadPool pool(1);
+    pool.runOpenCvLoops();
+    auto pipelineOwner = webcam::FramePipeline::create(webcam::SensorFormat::BGR888, {webcam::OutputConfig()}, pool,
+                                                       bandRows);
+    webcam::FramePipeline &pipeline = *pipelineOwner;
+    const cv::Rect region = pipeline.requiredSensorRegion();
+    cv::Mat aoi = frame(region).clone();
+    webcam::RawFrame aoiFrame = rawFrame;
+    aoiFrame.width = aoi.cols;
+    aoiFrame.height = aoi.rows;
+    aoiFrame.data = aoi.data;
+    aoiFrame.offsetX = region.x;
+    aoiFrame.offsetY = region.y;
+
+    std::cout << std::endl << "sensor area   pixels   mean ms   median ms   p95 ms" << std::endl;
+    std::cout << "full      " << std::setw(9) << frame.total();
+    printLatency("", measure(pipeline, rawFrame, frames));
+    std::cout << "AOI       " << std::setw(9) << aoi.total();
+    printLatency("", measure(pipeline, aoiFrame, frames));
+
+    // what a second, small output adds on top of the main one
+    std::cout << std::endl << "outputs        mean ms   median ms   p95 ms" << std::endl;
+    webcam::OutputConfig main;
+    webcam::OutputConfig preview;
+    preview.width = 160;
+    preview.height = 120;
+    auto simulcast = webcam::FramePipeline::create(webcam::SensorFormat::BGR888, {main, preview}, pool, bandRows);
+    std::cout << "640x480     ";
+    printLatency("", measure(pipeline, aoiFrame, frames));
+    std::cout << "+ 160x120   ";
+    printLatency("", measure(*simulcast, aoiFrame, frames));
+
+    // every pipeline variant on the AOI, with the data the camera would transfer in that format
+    std::cout << std::endl << "sensor format   bytes/frame   mean ms   median ms   p95 ms" << std::endl;
+    const std::pair<const char *, webcam::SensorFormat> formats[] = {
+        {"Mono8", webcam::SensorFormat::Mono8},
+        {"YUV422", webcam::SensorFormat::YUV422},
+        {"BGR888", webcam::SensorFormat::BGR888},
+    };
+    for (const auto &[name, format] : formats)
+    {
+        // the same image as frame, in that format
+        cv::Mat formatFrame = webcam::renderTestImage(frame.cols, frame.rows, format)(region).clone();
+        webcam::RawFrame formatRawFrame = aoiFrame;
+        formatRawFrame.channelCount = webcam::bytesPerPixel(format);
+        formatRawFrame.data = formatFrame.data;
+        auto variant = webcam::FramePipeline::create(format, {webcam::OutputConfig()}, pool, bandRows);
+        std::cout << std::left << std::setw(16) << name << std::right << std::setw(11)
+                  << formatFrame.total() * formatFrame.elemSize();
+        printLatency("", measure(*variant, formatRawFrame, frames));
+    }
+
+    // the color transform is applied while packing, a matrix ends up as a LUT just like a .cube file
+    std::cout << std::endl << "color transform   mean ms   median ms   p95 ms" << std::endl;
+    const std::array<double, 9> saturation{{1.3, -0.2, -0.1, -0.1, 1.2, -0.1, -0.1, -0.2, 1.3}};
+    std::cout << "off            ";
+    pipeline.setColorTransform(nullptr);
+    printLatency("", measure(pipeline, aoiFrame, frames));
+    std::cout << "matrix + gamma ";
+    pipeline.setColorTransform(webcam::ColorTransform::fromMatrix(saturation, {{1.1, 1.1, 1.1}}));
+    printLatency("", measure(pipeline, aoiFrame, frames));
+    return 0;
+}
@@ -0,0 +1,74 @@
+// Per-write overhead of changing the exposure time through CameraHelper compared
+// to a CachedProperty and a PropertyWriteBatch. Needs a camera.
+//
+//   ./webcam_property_bench [writes]
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <mvIMPACT_CPP/mvIMPACT_acquire.h>
+#include "../src/CameraHelper.hpp"
+#include "../src/PropertyCache.hpp"
+
+using namespace std::chrono;
+using namespace mvIMPACT::acquire;
+using webcam::Driver::CameraHelper;
+using webcam::Driver::CachedProperty;
+using webcam::Driver::PropertyWriteBatch;
+
+namespace {
+
+template<typename FUNC>
+void measure(const std::string &label, int writes, FUNC write) {
+    const auto start = steady_clock::now();
+    for (int i = 0; i < writes; i++)
+    {
+        // alternate so no layer can skip the write as unchanged
+        write(i % 2 == 0 ? 10000 : 10100);
+    }
+    const double perWrite = duration<double, std::micro>(steady_clock::now() - start).count() / writes;
+    std::cout << std::setw(32) << std::left << label << std::fixed << std::setprecision(2) << perWrite
+              << " us/write" << std::endl;
+}
+
+}
+
+int main(int argc, char **argv) {
+    const int writes = argc > 1 ? std::stoi(argv[1]) : 1000;
+
+    DeviceManager devMgr;
+    if (devMgr.deviceCount() == 0)
+    {
+        std::cout << "No compliant device found!" << std::endl;
+        return 1;
+    }
+    Device *dev = devMgr[0];
+    dev->open();
+    SettingsBlueFOX settings(dev);
+    const auto &expose = settings.cameraSetting.expose_us;
+
+    measure("CameraHelper", writes, [&expose](int value) {
+        CameraHelper::conditionalSetProperty(expose, value, true);
+    });
+
+    CachedProperty<PropertyI> cached(expose);
+    measure("CachedProperty", writes, [&cached](int value) {
+        cached.write(value);
+    });
+
+    PropertyWriteBatch batch;
+    measure("batch, applied every write", writes, [&batch, &cached](int value) {
+        batch.set(cached, value);
+        batch.apply();
+    });
+
+    measure("batch, applied every 10 writes", writes, [&batch, &cached, i = 0](int value) mutable {
+        batch.set(cached, value);
+        if (++i % 10 == 0)
+        {
+            batch.apply();
+        }
+    });
+    batch.apply();
+    return 0;
+}
@@ -0,0 +1,180 @@
+// How the process scales with the number of cameras: 1, 2, 4, ... up to the
+// given count of synthetic cameras (see SyntheticCamera) at 30 fps, each with
+// its own capture thread (CaptureLoop) and pipeline, sharing one thread pool
+// as the cameras of CameraManager do. Reports the frames processed per camera
+// and second, frames the sensor finished without a free request, the latency
+// from the end of exposure to the processed frame and the CPU time per frame.
+// With a fault rate the cameras also return bad requests (at that rate per
+// frame), go silent for a second (a tenth of it) and get lost (a hundredth of
+// it). Each camera's capture runs under a CaptureWatchdog as in Camera, which
+// brings stalled and lost cameras back; its recoveries and the longest outage
+// are reported.
+//
+//   ./webcam_scale_bench [cameras] [seconds per run] [fault rate]
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include <opencv2/opencv.hpp>
+#include "../src/CaptureWatchdog.hpp"
+#include "../src/FaceDetector.hpp"
+#include "../src/FramePipeline.hpp"
+#include "../src/Metrics.hpp"
+#include "../src/SyntheticCamera.hpp"
+#include "../src/ThreadPool.hpp"
+#include "../src/Undistortion.hpp"
+
+using namespace std::chrono;
+
+namespace {
+
+struct VirtualCamera {
+    std::string name;
+    std::unique_ptr<webcam::SyntheticCamera> device;
+    std::unique_ptr<webcam::FramePipeline> pipeline;
+    // after the device and the pipeline, its capture thread uses both
+    std::unique_ptr<webcam::CaptureWatchdog> watchdog;
+    std::atomic<unsigned long> processed{0};
+    std::atomic<unsigned long> failed{0};
+    std::atomic<unsigned long> reopens{0};
+    std::mutex latencyMutex;
+    std::vector<double> latencies_ms;
+
+    void onRequest(const webcam::CaptureRequest &request) {
+        if (!request.ok)
+        {
+            failed++;
+            return;
+        }
+        pipeline->process(request.frame);
+        const double latency_ms = duration<double, std::milli>(
+                steady_clock::now().time_since_epoch() - microseconds(request.timestamp_us)).count();
+        processed++;
+        std::lock_guard<std::mutex> lock(latencyMutex);
+        latencies_ms.push_back(latency_ms);
+    }
+};
+
+double cpuSeconds() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+double percentile(std::vector<double> values, double fraction) {
+    if (values.empty())
+    {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, static_cast<size_t>(fraction * values.size()))];
+}
+
+void run(int count, int seconds, double faultRate) {
+    webcam::ThreadPool pool(std::max(std::thread::hardware_concurrency(), 1u));
+    pool.runOpenCvLoops();
+    std::vector<std::unique_ptr<VirtualCamera>> cameras;
+    for (int i = 0; i < count; i++)
+    {
+        webcam::SyntheticCameraConfig config;
+        config.width = webcam::Undistortion::cameraWidth;
+        config.height = webcam::Undistortion::cameraHeight;
+        config.badRequestRate = faultRate;
+        config.timeoutRate = faultRate / 10;
+        config.deviceLossRate = faultRate / 100;
+        config.seed = static_cast<unsigned int>(i + 1);
+        auto camera = std::make_unique<VirtualCamera>();
+        // the metrics of every run on their own
+        camera->name = "scale" + std::to_string(count) + ".camera" + std::to_string(i);
+        camera->device = std::make_unique<webcam::SyntheticCamera>(config);
+        camera->pipeline = webcam::FramePipeline::create(config.format, {webcam::OutputConfig()}, pool, 32);
+        webcam::CaptureWatchdog::Handlers handlers;
+        handlers.request = [&target = *camera](const webcam::CaptureRequest &request) { target.onRequest(request); };
+        handlers.reopened = [&target = *camera] { target.reopens++; };
+        camera->watchdog = std::make_unique<webcam::CaptureWatchdog>(*camera->device, camera->name,
+                                                                     config.framesPerSecond, std::move(handlers));
+        cameras.push_back(std::move(camera));
+    }
+
+    const auto start = steady_clock::now();
+    const double cpuStart = cpuSeconds();
+    for (auto &camera : cameras)
+    {
+        camera->watchdog->setRunning(true);
+    }
+    std::this_thread::sleep_for(seconds * 1s);
+    for (auto &camera : cameras)
+    {
+        camera->watchdog->setRunning(false);
+    }
+    const double wall_s = duration<double>(steady_clock::now() - start).count();
+    const double cpu_s = cpuSeconds() - cpuStart;
+
+    unsigned long processed = 0;
+    unsigned long lost = 0;
+    unsigned long failed = 0;
+    unsigned long reopens = 0;
+    double maxOutage_ms = 0;
+    std::vector<double> latencies_ms;
+    for (auto &camera : cameras)
+    {
+        processed += camera->processed;
+        lost += camera->device->statistics().lost;
+        failed += camera->failed;
+        reopens += camera->reopens;
+        maxOutage_ms = std::max(maxOutage_ms,
+                                webcam::Metrics::global().gauge(camera->name + ".watchdog.maxOutage_ms").load());
+        latencies_ms.insert(latencies_ms.end(), camera->latencies_ms.begin(), camera->latencies_ms.end());
+    }
+    std::cout << std::setw(7) << count << std::fixed << std::setprecision(1)
+              << std::setw(12) << processed / wall_s / count
+              << std::setw(7) << lost
+              << std::setw(11) << percentile(latencies_ms, 0.5)
+              << std::setw(9) << percentile(latencies_ms, 0.99)
+              << std::setw(11) << (processed > 0 ? cpu_s * 1e3 / processed : 0)
+              << std::setw(7) << 100 * cpu_s / wall_s / std::max(std::thread::hardware_concurrency(), 1u);
+    if (faultRate > 0)
+    {
+        std::cout << std::setw(8) << failed << std::setw(8) << reopens << std::setw(12) << maxOutage_ms;
+    }
+    std::cout << std::endl;
+}
+
+}
+
+int main(int argc, char **argv) {
+    const int maxCameras = argc > 1 ? std::stoi(argv[1]) : 16;
+    const int seconds = argc > 2 ? std::stoi(argv[2]) : 5;
+    const double faultRate = argc > 3 ? std::stod(argv[3]) : 0;
+    if (maxCameras <= 0 || seconds <= 0 || faultRate < 0 || faultRate > 1)
+    {
+        std::cout << "usage: " << argv[0] << " [cameras] [seconds per run] [fault rate]" << std::endl;
+        return 1;
+    }
+
+    webcam::Undistortion::prepare();
+    webcam::FaceDetector::prepare();
+
+    std::cout << "cameras   fps/camera   lost   p50 ms   p99 ms   cpu ms/frame   cpu %";
+    if (faultRate > 0)
+    {
+        std::cout << "   failed   reopens   outage ms";
+    }
+    std::cout << std::endl;
+    for (int count = 1;; count = std::min(count * 2, maxCameras))
+    {
+        run(count, seconds, faultRate);
+        if (count == maxCameras)
+        {
+            break;
+        }
+    }
+    return 0;
+}
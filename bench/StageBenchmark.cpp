@@ -0,0 +1,413 @@
+// Times every processing stage on a fixed reference frame and compares the
+// medians with a stored baseline, so an OpenCV or libyuv upgrade or a change to
+// the processing that costs frame time shows up as a failure. Undistortion
+// (whole used region, and the face window as frames that don't search for faces do),
+// the temporal noise filter and face detection are timed on their own, conversion,
+// sharpening, resizing and packing inside the pipeline (FramePipeline::stageTimes),
+// the sink write as the copy and write(2) the pacer does. The full pipeline is
+// processing plus sink write. Single threaded, the reference frame is generated
+// from a fixed seed with the face of an image pasted in.
+//
+//   ./webcam_stage_bench [--frames <n>] [--face <image>] [--sink <file>] [--json <results file>]
+//                        [--baseline <file>] [--update-baseline]
+//
+// Exits with 1 if a stage's median is more than its tolerance (plus slack_ms) slower than
+// the baseline or the baseline has no median for it, unless it has none at all yet, which
+// is only a warning. --update-baseline writes the results into the baseline instead, keeping
+// its tolerances.
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <opencv2/opencv.hpp>
+#include "../src/FaceDetector.hpp"
+#include "../src/FramePipeline.hpp"
+#include "../src/PixelKernels.hpp"
+#include "../src/SyntheticCamera.hpp"
+#include "../src/TemporalDenoiser.hpp"
+#include "../src/ThreadPool.hpp"
+#include "../src/Undistortion.hpp"
+
+using namespace std::chrono;
+
+namespace {
+
+// as in FramePipeline
+const cv::Rect usedRegion(0, 40, webcam::Undistortion::cameraWidth, 400);
+// around the face pasted into the reference frame, in usedRegion
+const cv::Rect faceWindow(226, 50, 300, 300);
+constexpr int denoiseStrength = 60;
+constexpr int warmUpFrames = 10;
+constexpr double defaultTolerance = 0.15;
+constexpr double defaultSlack_ms = 0.05;
+
+struct Result {
+    std::string stage;
+    double median_ms;
+    double p95_ms;
+    double mean_ms;
+};
+
+Result summarize(const std::string &stage, std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    double sum = 0;
+    for (double sample : samples)
+    {
+        sum += sample;
+    }
+    return {stage, samples[samples.size() / 2], samples[samples.size() * 95 / 100], sum / samples.size()};
+}
+
+struct Baseline {
+    std::map<std::string, double> tolerance;
+    double slack_ms{defaultSlack_ms};
+    std::string cpuLevel;
+    std::map<std::string, double> median_ms;
+
+    double toleranceOf(const std::string &stage) const {
+        auto found = tolerance.find(stage);
+        if (found == tolerance.end())
+        {
+            found = tolerance.find("default");
+        }
+        return found == tolerance.end() ? defaultTolerance : found->second;
+    }
+};
+
+Baseline readBaseline(const std::string &file) {
+    Baseline baseline;
+    cv::FileStorage storage(file, cv::FileStorage::READ);
+    if (!storage.isOpened())
+    {
+        throw std::runtime_error("Can't read baseline " + file);
+    }
+    for (const cv::FileNode &node : storage["tolerance"])
+    {
+        baseline.tolerance[node.name()] = static_cast<double>(node);
+    }
+    if (!storage["slack_ms"].empty())
+    {
+        baseline.slack_ms = static_cast<double>(storage["slack_ms"]);
+    }
+    if (!storage["cpuLevel"].empty())
+    {
+        baseline.cpuLevel = static_cast<std::string>(storage["cpuLevel"]);
+    }
+    for (const cv::FileNode &node : storage["stages"])
+    {
+        baseline.median_ms[node.name()] = static_cast<double>(node["median_ms"]);
+    }
+    return baseline;
+}
+
+// the baseline file too, with tolerances if given
+void writeResults(const std::string &file, const std::vector<Result> &results, int frames,
+                  const Baseline *tolerances) {
+    cv::FileStorage storage(file, cv::FileStorage::WRITE | cv::FileStorage::FORMAT_JSON);
+    if (!storage.isOpened())
+    {
+        throw std::runtime_error("Can't write " + file);
+    }
+    storage << "cpuLevel" << webcam::name(webcam::cpuLevel());
+    storage << "opencv" << CV_VERSION;
+    storage << "frames" << frames;
+    if (tolerances != nullptr)
+    {
+        storage << "tolerance" << "{";
+        storage << "default" << tolerances->toleranceOf("default");
+        for (const auto &[stage, tolerance] : tolerances->tolerance)
+        {
+            if (stage != "default")
+            {
+                storage << stage << tolerance;
+            }
+        }
+        storage << "}";
+        storage << "slack_ms" << tolerances->slack_ms;
+    }
+    storage << "stages" << "{";
+    for (const Result &result : results)
+    {
+        storage << result.stage << "{" << "median_ms" << result.median_ms << "p95_ms" << result.p95_ms
+                << "mean_ms" << result.mean_ms << "}";
+    }
+    storage << "}";
+}
+
+// the synthetic camera's image from a fixed seed, with the face from faceImage pasted
+// in the middle so detection and framing have something to do
+cv::Mat makeReferenceFrame(const cv::Mat &face) {
+    cv::Mat frame = webcam::renderTestImage(webcam::Undistortion::cameraWidth, webcam::Undistortion::cameraHeight,
+                                            webcam::SensorFormat::BGR888, 20240601);
+    cv::Mat patch;
+    cv::resize(face, patch, cv::Size(200, 200));
+    cv::cvtColor(patch, patch, cv::COLOR_BGR2RGB);
+    patch.copyTo(frame(cv::Rect((frame.cols - patch.cols) / 2, (frame.rows - patch.rows) / 2, patch.cols,
+                                patch.rows)));
+    return frame;
+}
+
+// the face found in image with some room around it
+cv::Mat findFace(const cv::Mat &image, webcam::FaceDetector &detector) {
+    cv::Mat bgra;
+    cv::cvtColor(image, bgra, cv::COLOR_BGR2BGRA);
+    const auto found = detector.detectFaces(bgra);
+    if (found.empty())
+    {
+        return cv::Mat();
+    }
+    const cv::Rect box = found.front().box;
+    const cv::Rect region = cv::Rect(box.x - box.width / 4, box.y - box.height / 4, box.width * 3 / 2,
+                                     box.height * 3 / 2) & cv::Rect(0, 0, image.cols, image.rows);
+    return image(region).clone();
+}
+
+std::vector<double> timeFrames(int frames, const std::function<void()> &body) {
+    for (int i = 0; i < warmUpFrames; i++)
+    {
+        body();
+    }
+    std::vector<double> samples;
+    for (int i = 0; i < frames; i++)
+    {
+        const auto start = steady_clock::now();
+        body();
+        samples.push_back(duration<double, std::milli>(steady_clock::now() - start).count());
+    }
+    return samples;
+}
+
+int usage(const char *program) {
+    std::cout << "usage: " << program << " [--frames <n>] [--face <image>] [--sink <file>] [--json <results file>]\n"
+              << "       [--baseline <file>] [--update-baseline]" << std::endl;
+    return 1;
+}
+
+}
+
+int main(int argc, char **argv) {
+    int frames = 300;
+    std::string faceFile;
+    std::string sinkFile = "/dev/null";
+    std::string jsonFile;
+    std::string baselineFile = WEBCAM_STAGE_BASELINE;
+    bool updateBaseline = false;
+    try
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            {
+                frames = std::stoi(argv[++i]);
+            }
+            else if (strcmp(argv[i], "--face") == 0 && i + 1 < argc)
+            {
+                faceFile = argv[++i];
+            }
+            else if (strcmp(argv[i], "--sink") == 0 && i + 1 < argc)
+            {
+                sinkFile = argv[++i];
+            }
+            else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+            {
+                jsonFile = argv[++i];
+            }
+            else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+            {
+                baselineFile = argv[++i];
+            }
+            else if (strcmp(argv[i], "--update-baseline") == 0)
+            {
+                updateBaseline = true;
+            }
+            else
+            {
+                return usage(argv[0]);
+            }
+        }
+        if (faceFile.empty())
+        {
+            faceFile = cv::samples::findFile("lena.jpg");
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cout << e.what() << std::endl;
+        return usage(argv[0]);
+    }
+    const cv::Mat image = cv::imread(faceFile);
+    if (image.empty() || frames <= 0)
+    {
+        return usage(argv[0]);
+    }
+
+    cv::setNumThreads(1);
+    webcam::FaceDetector detector;
+    while (!detector.ready())
+    {
+        std::this_thread::sleep_for(milliseconds(10));
+    }
+    const cv::Mat face = findFace(image, detector);
+    if (face.empty())
+    {
+        std::cout << "No face in " << faceFile << std::endl;
+        return 1;
+    }
+    cv::Mat frame = makeReferenceFrame(face);
+    webcam::RawFrame rawFrame;
+    rawFrame.width = frame.cols;
+    rawFrame.height = frame.rows;
+    rawFrame.channelCount = frame.channels();
+    rawFrame.data = frame.data;
+
+    std::vector<Result> results;
+
+    // the stages that run on the whole used region, on their own
+    cv::Mat bgra;
+    cv::cvtColor(frame, bgra, cv::COLOR_RGB2BGRA);
+    webcam::Undistortion undistortion;
+    undistortion.setLayout(usedRegion, cv::Point(0, 0), 1, 1);
+    cv::Mat region(usedRegion.size(), CV_8UC4);
+    results.push_back(summarize("undistortion", timeFrames(frames, [&] {
+        undistortion.undistortImage(bgra, region, 0, region.rows);
+    })));
+    // moving by a pixel every frame, so the window map gets rebuilt as while following a face
+    cv::Mat window(faceWindow.size(), CV_8UC4);
+    int windowFrame = 0;
+    results.push_back(summarize("window", timeFrames(frames, [&] {
+        undistortion.setWindow(faceWindow + cv::Point(windowFrame++ % 2, 0), faceWindow.size());
+        undistortion.undistortWindow(bgra, window, 0, window.rows);
+    })));
+    // the frames are the same, a static scene is the filter's usual case
+    webcam::TemporalDenoiser denoiser(region.size(), denoiseStrength);
+    results.push_back(summarize("denoise", timeFrames(frames, [&] {
+        denoiser.beginFrame();
+        denoiser.filterRows(region, 0, region.rows);
+    })));
+    results.push_back(summarize("detection", timeFrames(frames, [&] {
+        detector.detectFaces(region);
+    })));
+
+    // the others inside the pipeline, with the window following the face as with a camera
+    webcam::ThreadPool pool(1);
+    auto pipeline = webcam::FramePipeline::create(webcam::SensorFormat::BGR888, {webcam::OutputConfig()}, pool, 32);
+    while (!pipeline->faceDetectionReady())
+    {
+        std::this_thread::sleep_for(milliseconds(10));
+    }
+    const int sink = open(sinkFile.c_str(), O_WRONLY | O_CREAT, 0644);
+    if (sink < 0)
+    {
+        std::cout << "Can't open " << sinkFile << std::endl;
+        return 1;
+    }
+    std::vector<uint8_t> pending;
+    std::vector<double> sinkWrite_ms;
+    const auto writeSink = [&](const cv::Mat &packed) {
+        const auto start = steady_clock::now();
+        // as LoopbackSink: submit() copies, the writer thread writes
+        const size_t size = packed.elemSize() * packed.total();
+        pending.resize(size);
+        std::memcpy(pending.data(), packed.data, size);
+        if (pwrite(sink, pending.data(), size, 0) != static_cast<ssize_t>(size))
+        {
+            throw std::runtime_error("Can't write " + sinkFile);
+        }
+        sinkWrite_ms.push_back(duration<double, std::milli>(steady_clock::now() - start).count());
+    };
+    std::vector<webcam::StageTimes> stageTimes;
+    const std::vector<double> pipeline_ms = timeFrames(frames, [&] {
+        writeSink(pipeline->process(rawFrame));
+        stageTimes.push_back(pipeline->stageTimes());
+    });
+    close(sink);
+    // without the warm-up frames
+    stageTimes.erase(stageTimes.begin(), stageTimes.begin() + warmUpFrames);
+    sinkWrite_ms.erase(sinkWrite_ms.begin(), sinkWrite_ms.begin() + warmUpFrames);
+    const auto pipelineStage = [&](const char *stage, double webcam::StageTimes::*time) {
+        std::vector<double> samples;
+        for (const auto &times : stageTimes)
+        {
+            samples.push_back(times.*time);
+        }
+        results.push_back(summarize(stage, samples));
+    };
+    pipelineStage("convert", &webcam::StageTimes::convert_ms);
+    pipelineStage("sharpening", &webcam::StageTimes::sharpen_ms);
+    pipelineStage("resize", &webcam::StageTimes::scale_ms);
+    pipelineStage("pack", &webcam::StageTimes::pack_ms);
+    results.push_back(summarize("sink", sinkWrite_ms));
+    results.push_back(summarize("pipeline", pipeline_ms));
+
+    if (!jsonFile.empty())
+    {
+        writeResults(jsonFile, results, frames, nullptr);
+    }
+
+    Baseline baseline;
+    try
+    {
+        baseline = readBaseline(baselineFile);
+    }
+    catch (const std::exception &e)
+    {
+        if (!updateBaseline)
+        {
+            std::cout << e.what() << std::endl;
+            return 1;
+        }
+    }
+    if (updateBaseline)
+    {
+        writeResults(baselineFile, results, frames, &baseline);
+        std::cout << "Baseline written to " << baselineFile << std::endl;
+    }
+    if (!baseline.cpuLevel.empty() && baseline.cpuLevel != webcam::name(webcam::cpuLevel()))
+    {
+        std::cout << "Baseline was recorded with " << baseline.cpuLevel << " kernels, this machine uses "
+                  << webcam::name(webcam::cpuLevel()) << std::endl;
+    }
+
+    std::cout << "stage          median ms   p95 ms   baseline ms   change" << std::endl;
+    bool regressed = false;
+    bool unrecorded = false;
+    for (const Result &result : results)
+    {
+        std::cout << std::left << std::setw(13) << result.stage << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(11) << result.median_ms << std::setw(9) << result.p95_ms;
+        const auto reference = baseline.median_ms.find(result.stage);
+        if (updateBaseline)
+        {
+            std::cout << std::setw(14) << "-" << std::endl;
+            continue;
+        }
+        if (reference == baseline.median_ms.end())
+        {
+            unrecorded = true;
+            std::cout << std::setw(14) << "-" << "           NO BASELINE" << std::endl;
+            continue;
+        }
+        const double limit_ms = reference->second * (1 + baseline.toleranceOf(result.stage)) + baseline.slack_ms;
+        const bool stageRegressed = result.median_ms > limit_ms;
+        regressed = regressed || stageRegressed;
+        std::cout << std::setw(14) << reference->second << std::showpos << std::setprecision(0) << std::setw(8)
+                  << 100 * (result.median_ms / reference->second - 1) << "%" << std::noshowpos
+                  << (stageRegressed ? "  REGRESSED" : "") << std::endl;
+    }
+    // a baseline without any stages hasn't been recorded yet, a stage missing from one that has is new
+    const bool recorded = !baseline.median_ms.empty();
+    if (unrecorded)
+    {
+        std::cout << (recorded ? "Stages" : "Warning: stages") << " without a baseline, record one with --update-baseline"
+                  << std::endl;
+    }
+    return regressed || (unrecorded && recorded) ? 1 : 0;
+}
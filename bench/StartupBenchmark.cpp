@@ -0,0 +1,91 @@
+// Time to the first processed frame and to working face detection, from
+// program start, for a number of cameras started at the same time. Does what
+// CameraManager does at startup minus the devices: the shared models are
+// prepared first, then every camera builds its pipeline on its own thread and
+// processes frames until its face detector is ready.
+// Each run is a fresh process, run it with 1 and with 4 cameras.
+//
+//   ./webcam_startup_bench [cameras]
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "../src/FramePipeline.hpp"
+#include "../src/ThreadPool.hpp"
+#include "../src/Undistortion.hpp"
+#include "../src/FaceDetector.hpp"
+
+using namespace std::chrono;
+
+namespace {
+
+const auto programStart = steady_clock::now();
+
+double sinceStart_ms() {
+    return duration<double, std::milli>(steady_clock::now() - programStart).count();
+}
+
+}
+
+int main(int argc, char **argv) {
+    const int cameras = argc > 1 ? std::stoi(argv[1]) : 1;
+    if (cameras <= 0)
+    {
+        std::cout << "usage: " << argv[0] << " [cameras]" << std::endl;
+        return 1;
+    }
+
+    webcam::Undistortion::prepare();
+    webcam::FaceDetector::prepare();
+    webcam::ThreadPool pool(std::max(std::thread::hardware_concurrency(), 1u));
+    // as the camera manager sets it up
+    pool.runOpenCvLoops();
+
+    cv::Mat frame(webcam::Undistortion::cameraHeight, webcam::Undistortion::cameraWidth, CV_8UC3);
+    cv::randu(frame, cv::Scalar::all(0), cv::Scalar::all(255));
+    webcam::RawFrame rawFrame;
+    rawFrame.width = frame.cols;
+    rawFrame.height = frame.rows;
+    rawFrame.channelCount = frame.channels();
+    rawFrame.data = frame.data;
+
+    std::vector<double> created(cameras);
+    std::vector<double> firstFrame(cameras);
+    std::vector<double> detectionReady(cameras);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < cameras; i++)
+    {
+        threads.emplace_back([&, i] {
+            webcam::OutputConfig output;
+            output.device = "/dev/video" + std::to_string(i);
+            auto pipeline = webcam::FramePipeline::create(webcam::SensorFormat::BGR888, {output}, pool, 32);
+            created[i] = sinceStart_ms();
+            pipeline->process(rawFrame);
+            firstFrame[i] = sinceStart_ms();
+            // streaming goes on while the detector loads, at most at the camera's frame rate
+            while (!pipeline->faceDetectionReady() && sinceStart_ms() < 10000)
+            {
+                pipeline->process(rawFrame);
+                std::this_thread::sleep_for(milliseconds(10));
+            }
+            // negative if the cascade couldn't be loaded
+            detectionReady[i] = pipeline->faceDetectionReady() ? sinceStart_ms() : -1;
+        });
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+
+    std::cout << "camera   pipeline ms   first frame ms   detection ms" << std::endl;
+    for (int i = 0; i < cameras; i++)
+    {
+        std::cout << std::setw(6) << i << std::fixed << std::setprecision(1) << std::setw(14) << created[i]
+                  << std::setw(17) << firstFrame[i] << std::setw(15) << detectionReady[i] << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,153 @@
+// Undistorting the whole used region and cutting the face window from it,
+// against undistorting only the window from the interpolated grid
+// (Undistortion::setWindow), single threaded. Also with a window that moves
+// every frame, so the window map is rebuilt each time, and with the scaling to
+// an output size folded into the undistortion. The difference to the full path
+// shows what the grid interpolation costs in accuracy, in 8 bit levels. Last the
+// lens shading correction, applied in the remap pass versus as a pass of its own
+// over the undistorted region, on a flat field falling off like cos^4.
+//
+//   ./webcam_undistort_bench [frames]
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <opencv2/opencv.hpp>
+#include "../src/PixelKernels.hpp"
+#include "../src/Undistortion.hpp"
+
+using namespace std::chrono;
+
+namespace {
+
+// as in FramePipeline
+const cv::Rect usedRegion(0, 40, webcam::Undistortion::cameraWidth, 400);
+const cv::Rect faceWindow(200, 70, 250, 250);
+const cv::Size outputSize(640, 480);
+
+double time_ms(int frames, const std::function<void(int)> &body) {
+    const auto start = steady_clock::now();
+    for (int i = 0; i < frames; i++)
+    {
+        body(i);
+    }
+    return duration<double, std::milli>(steady_clock::now() - start).count() / frames;
+}
+
+// what a lens with the calibration's focal length shows of a white wall
+cv::Mat makeFlatField() {
+    cv::Mat flatField(webcam::Undistortion::cameraHeight, webcam::Undistortion::cameraWidth, CV_8UC1);
+    const double focalLength = 425;
+    for (int y = 0; y < flatField.rows; y++)
+    {
+        for (int x = 0; x < flatField.cols; x++)
+        {
+            const double dx = x - flatField.cols / 2.0;
+            const double dy = y - flatField.rows / 2.0;
+            const double cosine = focalLength / std::sqrt(focalLength * focalLength + dx * dx + dy * dy);
+            flatField.at<uint8_t>(y, x) = cv::saturate_cast<uint8_t>(240 * std::pow(cosine, 4));
+        }
+    }
+    return flatField;
+}
+
+void print(const std::string &name, double ms, const cv::Mat &result, const cv::Mat &reference) {
+    std::cout << std::left << std::setw(34) << name << std::right << std::fixed << std::setprecision(3)
+              << std::setw(10) << ms;
+    if (!reference.empty())
+    {
+        cv::Mat difference;
+        cv::absdiff(result, reference, difference);
+        double maxDifference;
+        cv::minMaxLoc(difference.reshape(1), nullptr, &maxDifference);
+        std::cout << std::setprecision(2) << std::setw(10) << cv::mean(difference.reshape(1))[0]
+                  << std::setprecision(0) << std::setw(6) << maxDifference;
+    }
+    std::cout << std::endl;
+}
+
+}
+
+int main(int argc, char **argv) {
+    const int frames = argc > 1 ? std::stoi(argv[1]) : 200;
+    if (frames <= 0)
+    {
+        std::cout << "usage: " << argv[0] << " [frames]" << std::endl;
+        return 1;
+    }
+    cv::setNumThreads(1);
+
+    // noise blurred to image like detail, pure noise would exaggerate every interpolation difference
+    cv::Mat frame(webcam::Undistortion::cameraHeight, webcam::Undistortion::cameraWidth, CV_8UC4);
+    cv::randu(frame, cv::Scalar::all(0), cv::Scalar::all(255));
+    cv::GaussianBlur(frame, frame, cv::Size(), 2);
+
+    webcam::Undistortion undistortion;
+    undistortion.setLayout(usedRegion, cv::Point(0, 0), 1, 1);
+
+    std::cout << "                                  ms/frame  mean diff  max" << std::endl;
+    cv::Mat region(usedRegion.size(), CV_8UC4);
+    const double full_ms = time_ms(frames, [&](int) {
+        undistortion.undistortImage(frame, region, 0, region.rows);
+    });
+    const cv::Mat reference = region(faceWindow).clone();
+    print("whole region, cut window", full_ms, reference, cv::Mat());
+
+    cv::Mat window(faceWindow.size(), CV_8UC4);
+    undistortion.setWindow(faceWindow, faceWindow.size());
+    const double window_ms = time_ms(frames, [&](int) {
+        undistortion.undistortWindow(frame, window, 0, window.rows);
+    });
+    print("window only", window_ms, window, reference);
+
+    const double moving_ms = time_ms(frames, [&](int i) {
+        undistortion.setWindow(faceWindow + cv::Point(i % 2, 0), faceWindow.size());
+        undistortion.undistortWindow(frame, window, 0, window.rows);
+    });
+    print("window only, moving", moving_ms, window, cv::Mat());
+
+    cv::Mat scaled;
+    const double fullScaled_ms = time_ms(frames, [&](int) {
+        undistortion.undistortImage(frame, region, 0, region.rows);
+        cv::resize(region(faceWindow), scaled, outputSize, 0, 0, cv::INTER_LINEAR);
+    });
+    const cv::Mat scaledReference = scaled.clone();
+    print("whole region, cut and scale", fullScaled_ms, scaledReference, cv::Mat());
+
+    cv::Mat folded(outputSize, CV_8UC4);
+    undistortion.setWindow(faceWindow, outputSize);
+    const double folded_ms = time_ms(frames, [&](int) {
+        undistortion.undistortWindow(frame, folded, 0, folded.rows);
+    });
+    print("window scaled while undistorting", folded_ms, folded, scaledReference);
+
+    // shading corrected, the plain undistortion above is the reference for the separate pass
+    webcam::Undistortion shaded;
+    shaded.setShading(webcam::Undistortion::shadingFromFlatField(makeFlatField()));
+    shaded.setLayout(usedRegion, cv::Point(0, 0), 1, 1);
+    const cv::Mat &gain = shaded.regionGain();
+    const auto gainRow = webcam::pixelKernels().gainBGRA;
+    const double separate_ms = time_ms(frames, [&](int) {
+        undistortion.undistortImage(frame, region, 0, region.rows);
+        for (int row = 0; row < region.rows; row++)
+        {
+            gainRow(region.ptr(row), gain.ptr<uint16_t>(row), region.cols);
+        }
+    });
+    const cv::Mat shadedReference = region.clone();
+    print("whole region, separate shading", separate_ms, shadedReference, cv::Mat());
+
+    const double fused_ms = time_ms(frames, [&](int) {
+        shaded.undistortImage(frame, region, 0, region.rows);
+    });
+    print("whole region, shading in remap", fused_ms, region, shadedReference);
+
+    shaded.setWindow(faceWindow, faceWindow.size());
+    const double shadedWindow_ms = time_ms(frames, [&](int) {
+        shaded.undistortWindow(frame, window, 0, window.rows);
+    });
+    print("window only, shading in remap", shadedWindow_ms, window, shadedReference(faceWindow));
+    return 0;
+}
@@ -1,16 +1,37 @@
 #include "Camera.hpp"
 #include "CameraHelper.hpp"
+#include "Trace.hpp"
+#include "Metrics.hpp"
 #include <stdexcept>
 #include <iostream>
+#include <algorithm>
+#include <cmath>
 
 namespace webcam::Driver {
 
-Camera::Camera(Device *dev) : _dev(dev), _webcam("/dev/video0", 640, 480) {
+CameraConfig Camera::loadConfig(Device *dev) {
     if (dev == nullptr)
     {
         throw std::invalid_argument("nullptr");
     }
+    return CameraConfig::load(dev->serial.read());
+}
+
+std::string Camera::serial() const {
+    return _dev->serial.read();
+}
+
+template<typename _Ty>
+void Camera::addSetting(const std::string &key, const _Ty &prop) {
+    _settingHandlers.emplace(key, [prop](const std::string &value) {
+        return CameraHelper::setPropertyFromString(prop, value);
+    });
+}
 
+Camera::Camera(Device *dev, ThreadPool &threadPool, int bandRows, std::chrono::steady_clock::time_point started)
+    : _dev(dev), _config(loadConfig(dev)), _started(started),
+      _jitterGauge(webcam::Metrics::global().gauge(dev->serial.read() + ".capture.jitter_us")),
+      _maxDeviationGauge(webcam::Metrics::global().gauge(dev->serial.read() + ".capture.maxDeviation_us")) {
     std::cout << _dev->serial.read() << " (" << _dev->product.read() << ", " << _dev->family.read();
     if (_dev->interfaceLayout.isValid())
     {
@@ -35,68 +56,389 @@ Camera::Camera(Device *dev) : _dev(dev), _webcam("/dev/video0", 640, 480) {
         }
     }
     std::cout << ")" << std::endl;
-    std::cout << "Opening device...";
 
+    _captureDevice = std::make_unique<ImpactCaptureDevice>(_dev);
+    _captureDevice->open();
+    configureDevice();
+
+    _webcam = std::make_unique<webcam::Webcam>(negotiateSensorFormat(), _config.outputs, threadPool, bandRows);
+    programSensorRegion();
+
+    _config.configure(*_webcam, serial(), demosaicStep());
+    createExposureController();
+
+    webcam::CaptureWatchdog::Handlers handlers;
+    handlers.request = [this](const webcam::CaptureRequest &request) { aquisitionCallback(request); };
+    handlers.starting = [this] {
+        _captureThreadScheduled = false;
+        _lastTimestamp_us = -1;
+    };
+    // the sinks repeat it until frames come again, consumers don't see a frozen picture
+    handlers.stalled = [this] { _webcam->publishPlaceholder(); };
+    handlers.closing = [this] { closeDevice(); };
+    handlers.reopened = [this] { deviceReopened(); };
+    _watchdog = std::make_unique<webcam::CaptureWatchdog>(*_captureDevice, serial(), _config.maxFramesPerSecond(),
+                                                          std::move(handlers));
+    // starts the acquisition right away unless the sink already knows nobody is watching
+    _webcam->setConsumerListener([this](bool active) { _watchdog->setRunning(active); });
+}
+
+Camera::~Camera() {
+    _webcam->setConsumerListener(nullptr);
+    _watchdog.reset();
+}
+
+void Camera::configureDevice() {
+    // Set Properties
+    _settings = std::make_unique<mvIMPACT::acquire::SettingsBlueFOX>(_dev); // Using the "Base" settings (default)
+    auto &cameraSetting = _settings->cameraSetting;
+    addSetting("exposeUpperLimit_us", cameraSetting.autoControlParameters.exposeUpperLimit_us);
+    addSetting("gainUpperLimit_dB", cameraSetting.autoControlParameters.gainUpperLimit_dB);
+    addSetting("autoGainControl", cameraSetting.autoGainControl);
+    addSetting("autoExposeControl", cameraSetting.autoExposeControl);
+    addSetting("expose_us", cameraSetting.expose_us);
+    addSetting("gain_dB", cameraSetting.gain_dB);
+    addSetting("offsetAutoCalibration", cameraSetting.offsetAutoCalibration);
+    addSetting("aoiStartX", cameraSetting.aoiStartX);
+    addSetting("aoiStartY", cameraSetting.aoiStartY);
+    addSetting("aoiWidth", cameraSetting.aoiWidth);
+    addSetting("aoiHeight", cameraSetting.aoiHeight);
+    addSetting("binningMode", cameraSetting.binningMode);
+    addSetting("pixelClock_KHz", cameraSetting.pixelClock_KHz);
+    addSetting("bayerConversionMode", _settings->imageProcessing.bayerConversionMode);
+    addSetting("whiteBalance", _settings->imageProcessing.whiteBalance);
+
+    for (const auto &[key, value] : _config.cameraSettings)
+    {
+        writeSetting(key, value);
+    }
+    _demosaicMode = _settings->imageProcessing.bayerConversionMode.readS();
+}
+
+void Camera::createExposureController() {
+    if (!_config.hostExposureControl)
+    {
+        return;
+    }
+    // the same limits the camera's own control had, but never longer than a frame interval,
+    // that would cost frame rate
+    const double frameInterval_us = 1e6 / _config.maxFramesPerSecond();
+    double maxExpose_us = frameInterval_us;
+    double maxGain_dB = 12.0;
     try
     {
-        _dev->open();
+        maxExpose_us = std::min(frameInterval_us, std::stod(_config.cameraSetting("exposeUpperLimit_us")));
     }
-    catch (const ImpactAcquireException &e)
+    catch (const std::exception &)
+    {
+    }
+    try
+    {
+        maxGain_dB = std::stod(_config.cameraSetting("gainUpperLimit_dB"));
+    }
+    catch (const std::exception &)
     {
-        std::cout << "error" << std::endl;
-        // this e.g. might happen if the same device is already opened in another process...
-        std::cout << "An error occurred while opening the device " << _dev->serial.read()
-                  << "(error code: " << e.getErrorCodeAsString() << ").";
-        throw std::runtime_error("Error opening device");
     }
-    std::cout << "ok" << std::endl;
 
+    // the controller switches these off, whatever the config file says
+    std::string overridden;
+    for (const char *key : {"autoExposeControl", "autoGainControl", "whiteBalance"})
+    {
+        if (_config.explicitSettings.count(key) != 0)
+        {
+            overridden += std::string(overridden.empty() ? "" : ", ") + key + " = " + _config.cameraSetting(key);
+        }
+    }
+    if (!overridden.empty())
+    {
+        std::cout << serial() << ": hostExposureControl overrides " << overridden << std::endl;
+    }
+    std::cout << serial() << ": host exposure control up to " << maxExpose_us << " us and " << maxGain_dB << " dB"
+              << std::endl;
+    _exposureController = std::make_unique<ExposureController>(serial(), *_settings, _propertyWrites, maxExpose_us,
+                                                               maxGain_dB);
+    _webcam->setStatisticsEnabled(true);
+}
+
+void Camera::closeDevice() {
+    // the controller's properties go away with the settings
+    _propertyWrites.discard();
+    _exposureController.reset();
+    _settingHandlers.clear();
+    _settings.reset();
+}
+
+void Camera::deviceReopened() {
     try
     {
-        _functionInterface = std::make_unique<FunctionInterface>(_dev);
+        configureDevice();
+        // the config's bayerConversionMode is back
+        _cheapDemosaic = false;
+        // the pipeline is built for the format the device delivered so far
+        if (negotiateSensorFormat() != _webcam->sensorFormat())
+        {
+            throw std::runtime_error("sensor format changed");
+        }
+        programSensorRegion();
+        createExposureController();
     }
-    catch (const mvIMPACT::acquire::ImpactAcquireException &e)
+    catch (const ImpactAcquireException &e)
     {
-        // this e.g. might happen if the same device is already opened in another process...
-        std::cout << "An error occurred while creating the function interface on device " << _dev->serial.read()
-                  << "(error code: " << e.getErrorCode() << "(" << e.getErrorCodeAsString() << ")). " << std::endl;
-        throw;
+        throw std::runtime_error(e.getErrorCodeAsString());
     }
+}
 
-    // Set Properties
-    mvIMPACT::acquire::SettingsBlueFOX settings(_dev); // Using the "Base" settings (default)
+bool Camera::applySetting(const std::string &key, const std::string &value) {
+    // not while the watchdog reopens the device
+    const auto lock = _watchdog->lock();
+    return writeSetting(key, value);
+}
+
+bool Camera::writeSetting(const std::string &key, const std::string &value) {
+    const auto handler = _settingHandlers.find(key);
+    if (handler == _settingHandlers.end())
+    {
+        std::cout << serial() << ": unknown setting '" << key << "'" << std::endl;
+        return false;
+    }
+    if (!handler->second(value))
+    {
+        std::cout << serial() << ": value '" << value << "' not supported for '" << key << "'" << std::endl;
+        return false;
+    }
+    if (key == "binningMode")
+    {
+        updateBinning();
+    }
+    return true;
+}
+
+bool Camera::isConfigured(const std::string &keyPrefix) const {
+    return std::any_of(_config.cameraSettings.begin(), _config.cameraSettings.end(), [&keyPrefix](const auto &setting) {
+        return setting.first.compare(0, keyPrefix.size(), keyPrefix) == 0;
+    });
+}
+
+void Camera::updateBinning() {
+    auto &binningMode = _settings->cameraSetting.binningMode;
+    const auto mode = binningMode.isValid() ? binningMode.read() : cbmOff;
+    _binningX = (mode == cbmBinningH || mode == cbmBinningHV) ? 2 : 1;
+    _binningY = (mode == cbmBinningV || mode == cbmBinningHV) ? 2 : 1;
+}
+
+void Camera::programSensorRegion() {
+    auto &cameraSetting = _settings->cameraSetting;
+    if (!isConfigured("binningMode") && _webcam->binningIsLossless())
+    {
+        CameraHelper::conditionalSetProperty(cameraSetting.binningMode, cbmBinningHV);
+    }
+    updateBinning();
 
-    settings.cameraSetting.autoControlParameters.exposeUpperLimit_us.write(40000);
-    settings.cameraSetting.autoControlParameters.gainUpperLimit_dB.write(12.0);
-    settings.cameraSetting.autoGainControl.write(mvIMPACT::acquire::TAutoGainControl::agcOn);
-    settings.cameraSetting.autoExposeControl.write(mvIMPACT::acquire::TAutoExposureControl::aecOn);
-    settings.cameraSetting.offsetAutoCalibration.write(mvIMPACT::acquire::TAutoOffsetCalibration::aocOn);
-    settings.imageProcessing.bayerConversionMode.write(mvIMPACT::acquire::TBayerConversionMode::bcmAdaptiveEdgeSensingPlus);
-    settings.imageProcessing.whiteBalance.write(mvIMPACT::acquire::TWhiteBalanceParameter::wbpFluorescent);
+    if (isConfigured("aoi"))
+    {
+        return;
+    }
+    // only transfer and process the part of the sensor that ends up in the undistorted image,
+    // the AOI is given in (binned) image pixels so round outwards
+    const cv::Rect region = _webcam->requiredSensorRegion();
+    const int startX = region.x / _binningX;
+    const int startY = region.y / _binningY;
+    const int width = (region.br().x + _binningX - 1) / _binningX - startX;
+    const int height = (region.br().y + _binningY - 1) / _binningY - startY;
+    // shrink first, otherwise the new start might not be accepted with the old size
+    CameraHelper::conditionalSetProperty(cameraSetting.aoiWidth, width, true);
+    CameraHelper::conditionalSetProperty(cameraSetting.aoiHeight, height, true);
+    CameraHelper::conditionalSetProperty(cameraSetting.aoiStartX, startX, true);
+    CameraHelper::conditionalSetProperty(cameraSetting.aoiStartY, startY, true);
+
+    const double sensorPixels = static_cast<double>(Undistortion::cameraWidth) * Undistortion::cameraHeight;
+    std::cout << serial() << ": sensor AOI " << cameraSetting.aoiWidth.read() << "x" << cameraSetting.aoiHeight.read()
+              << "+" << cameraSetting.aoiStartX.read() << "+" << cameraSetting.aoiStartY.read()
+              << ", binning " << _binningX << "x" << _binningY << ", "
+              << static_cast<int>(100.0 * cameraSetting.aoiWidth.read() * cameraSetting.aoiHeight.read()
+                                  * _binningX * _binningY / sensorPixels)
+              << "% of the sensor" << std::endl;
+}
 
+void Camera::updateDemosaic() {
+    const bool cheap = _webcam->qualityReduced(webcam::QualityStep::Demosaic);
+    if (cheap == _cheapDemosaic)
+    {
+        return;
+    }
+    _cheapDemosaic = cheap;
+    // the driver demosaics on the host as well, linear interpolation costs the least
+    if (_webcam->sensorFormat() != webcam::SensorFormat::Mono8 && !_demosaicMode.empty())
+    {
+        writeSetting("bayerConversionMode", cheap ? cheapDemosaicMode : _demosaicMode);
+    }
+}
+
+bool Camera::demosaicStep() const {
+    return _webcam->sensorFormat() != webcam::SensorFormat::Mono8 && !_demosaicMode.empty()
+           && _demosaicMode != cheapDemosaicMode;
+}
+
+webcam::SensorFormat Camera::negotiateSensorFormat() {
+    // the format the driver hands the frames over in, the pipeline is built for it
     mvIMPACT::acquire::ImageDestination imgDst(_dev);
-    imgDst.pixelFormat.write(idpfBGR888Packed);
+    TImageDestinationPixelFormat requested = idpfBGR888Packed;
+    if (_config.sensorFormat == webcam::SensorFormat::Mono8)
+    {
+        requested = idpfMono8;
+    }
+    else if (_config.sensorFormat == webcam::SensorFormat::YUV422)
+    {
+        requested = idpfYUV422Packed;
+    }
+    CameraHelper::conditionalSetProperty(imgDst.pixelFormat, requested, true);
 
-    _requestProvider = std::make_unique<RequestProvider>(_dev);
-    _requestProvider->acquisitionStart(AquisitionCallbackStatic, std::ref(*this));
+    const TImageDestinationPixelFormat negotiated = imgDst.pixelFormat.read();
+    if (negotiated == idpfMono8)
+    {
+        std::cout << serial() << ": processing Mono8 frames" << std::endl;
+        return webcam::SensorFormat::Mono8;
+    }
+    if (negotiated == idpfYUV422Packed)
+    {
+        std::cout << serial() << ": processing YUV422 frames" << std::endl;
+        return webcam::SensorFormat::YUV422;
+    }
+    if (negotiated != idpfBGR888Packed)
+    {
+        std::cout << serial() << ": sensorFormat not supported by the device, using BGR888" << std::endl;
+        imgDst.pixelFormat.write(idpfBGR888Packed);
+    }
+    return webcam::SensorFormat::BGR888;
+}
 
+void Camera::startRecording(const std::string &file) {
+    // opened outside the lock, the capture thread keeps running meanwhile
+    auto recorder = std::make_unique<webcam::FrameRecorder>(file, serial());
+    {
+        std::lock_guard<std::mutex> lock(_recorderMutex);
+        std::swap(_recorder, recorder);
+    }
+    std::cout << serial() << ": recording to " << file << std::endl;
 }
-void Camera::aquisitionCallback(std::shared_ptr<Request> request) {
-    if (request->isOK())
+
+void Camera::stopRecording() {
+    std::unique_ptr<webcam::FrameRecorder> recorder;
     {
-        _webcam.publish(request->imageWidth.read(),
-                        request->imageHeight.read(),
-                        request->imageChannelCount.read(),
-                        request->imageData.read());
+        std::lock_guard<std::mutex> lock(_recorderMutex);
+        recorder = std::move(_recorder);
     }
-    else
+    // destroyed here, flushing doesn't hold up the capture thread
+    recorder.reset();
+}
+
+void Camera::setColorTransform(std::shared_ptr<const webcam::ColorTransform> transform) {
+    std::cout << serial() << ": color transform " << (transform ? transform->description() : "off") << std::endl;
+    _webcam->setColorTransform(std::move(transform));
+}
+
+RawFrame Camera::rawFrame(const webcam::CaptureRequest &request) const {
+    RawFrame frame = request.frame;
+    // offsets are in image pixels, the pipeline wants sensor pixels
+    frame.binningX = _binningX;
+    frame.binningY = _binningY;
+    frame.offsetX *= frame.binningX;
+    frame.offsetY *= frame.binningY;
+    return frame;
+}
+
+void Camera::measureJitter(const webcam::CaptureRequest &request) {
+    const auto arrival = std::chrono::steady_clock::now();
+    const int64_t timestamp_us = request.timestamp_us;
+    if (_lastTimestamp_us >= 0)
     {
-        std::cout << "Error: " << request->requestResult.readS() << std::endl;
+        const double arrivalDelta_us = std::chrono::duration<double, std::micro>(arrival - _lastArrival).count();
+        const double deviation_us = std::abs(arrivalDelta_us - static_cast<double>(timestamp_us - _lastTimestamp_us));
+        _jitter_us += (deviation_us - _jitter_us) / 16;
+        _jitterGauge = _jitter_us;
+        if (deviation_us > _maxDeviationGauge)
+        {
+            _maxDeviationGauge = deviation_us;
+        }
     }
+    _lastTimestamp_us = timestamp_us;
+    _lastArrival = arrival;
 }
 
-void Camera::AquisitionCallbackStatic(std::shared_ptr<Request> request, Camera &context) {
-    context.aquisitionCallback(request);
+void Camera::aquisitionCallback(const webcam::CaptureRequest &request) {
+    TRACE_THREAD_NAME("capture " + serial());
+    TRACE_SCOPE("frame", request.number);
+    if (!_captureThreadScheduled)
+    {
+        _captureThreadScheduled = true;
+        if (!_config.captureScheduling.isDefault())
+        {
+            webcam::applyScheduling(_config.captureScheduling, serial() + " capture thread");
+        }
+    }
+    // the previous frame is done, good moment to change settings
+    _propertyWrites.apply();
+
+    if (request.ok)
+    {
+        measureJitter(request);
+        // before the pacer decides, a replay should see everything the camera delivered
+        std::lock_guard<std::mutex> lock(_recorderMutex);
+        if (_recorder)
+        {
+            TRACE_SCOPE("record");
+            try
+            {
+                webcam::FrameInfo info;
+                info.timestamp_us = request.timestamp_us;
+                info.expose_us = request.expose_us;
+                info.gain_dB = request.gain_dB;
+                _recorder->record(rawFrame(request), info);
+            }
+            catch (const std::exception &e)
+            {
+                std::cout << "Error recording frame: " << e.what() << std::endl;
+            }
+        }
+    }
+
+    if (!_webcam->wantsFrame())
+    {
+        // sink would drop this frame anyway, give the request straight back to the driver
+        return;
+    }
+
+    if (request.ok)
+    {
+        try
+        {
+            _webcam->publish(rawFrame(request));
+            if (!_firstFramePublished)
+            {
+                _firstFramePublished = true;
+                const double firstFrame_ms = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - _started).count();
+                webcam::Metrics::global().gauge(serial() + ".startup.firstFrame_ms") = firstFrame_ms;
+                std::cout << serial() << ": first frame " << firstFrame_ms << " ms after start" << std::endl;
+            }
+            if (_exposureController)
+            {
+                _exposureController->update(_webcam->statistics());
+            }
+            updateDemosaic();
+        }
+        catch (const std::exception &e)
+        {
+            // e.g. a format the pipeline can't handle after a setting was changed,
+            // an exception would end the capture thread for good
+            std::cout << "Error processing frame: " << e.what() << std::endl;
+        }
+    }
+    else
+    {
+        webcam::Metrics::global().counter(serial() + ".capture.badRequests")++;
+        std::cout << "Error: " << request.result << std::endl;
+    }
 }
 
 }
\ No newline at end of file
@@ -1,31 +1,120 @@
 #pragma once
 #include <mvIMPACT_CPP/mvIMPACT_acquire.h>
 #include <memory>
-#include "AquireHelper.hpp"
+#include <mutex>
+#include <map>
+#include <string>
+#include <vector>
+#include <functional>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include "CaptureWatchdog.hpp"
+#include "ImpactCaptureDevice.hpp"
 #include "Webcam.hpp"
+#include "ThreadPool.hpp"
+#include "CameraConfig.hpp"
+#include "PropertyCache.hpp"
+#include "ExposureController.hpp"
+#include "FrameRecorder.hpp"
 
 using mvIMPACT::acquire::Device;
-using mvIMPACT::acquire::FunctionInterface;
-using mvIMPACT::acquire::helper::RequestProvider;
+using webcam::ThreadPool;
+using webcam::RawFrame;
+using webcam::Undistortion;
 
 namespace webcam::Driver {
 
 class Camera {
 public:
-    Camera(Device *);
+    /// \param started program start, the time to the first published frame is measured from there
+    Camera(Device *, ThreadPool &threadPool, int bandRows, std::chrono::steady_clock::time_point started);
+    ~Camera();
+
+    std::string serial() const;
+
+    /// \brief Writes a camera property by its config file key, works while acquiring.
+    /// \return false if the key is unknown or the device doesn't support the value
+    bool applySetting(const std::string &key, const std::string &value);
+
+    /// \brief Writes queued here are applied by the capture thread between two frames.
+    PropertyWriteBatch &propertyWrites() {
+        return _propertyWrites;
+    }
+
+    /// \brief Records every frame the camera delivers to file (see FrameRecorder), replacing
+    /// a running recording.
+    void startRecording(const std::string &file);
+    void stopRecording();
+
+    /// \brief Color correction of the published frames, null is none. Works while acquiring.
+    void setColorTransform(std::shared_ptr<const webcam::ColorTransform> transform);
 
 //TODO MOVE/COPY CONSTRUCTOR, OPERATOR
 private:
+
     Device *_dev;
+    CameraConfig _config;
+    static CameraConfig loadConfig(Device *dev);
     //std::thread _aquisitionThread;
     //bool _threadShouldRun{true};
 
-    void aquisitionCallback(std::shared_ptr<Request> pRequest);
-    static void AquisitionCallbackStatic(std::shared_ptr<Request> request, Camera &context);
+    void aquisitionCallback(const webcam::CaptureRequest &request);
+    RawFrame rawFrame(const webcam::CaptureRequest &request) const;
+    const std::chrono::steady_clock::time_point _started;
+    // only touched by the capture thread
+    bool _firstFramePublished{false};
+    // the driver starts a new capture thread with every acquisition start
+    bool _captureThreadScheduled{false};
+
+    // interarrival jitter as in RFC 3550: how much the host's arrival times wander
+    // against the camera's timestamps, smoothed over 16 frames
+    void measureJitter(const webcam::CaptureRequest &request);
+    int64_t _lastTimestamp_us{-1};
+    std::chrono::steady_clock::time_point _lastArrival;
+    double _jitter_us{0};
+    std::atomic<double> &_jitterGauge;
+    std::atomic<double> &_maxDeviationGauge;
+
+    // the watchdog reopens the device through these, with its lock held
+    void closeDevice();
+    void deviceReopened();
+
+    std::unique_ptr<ImpactCaptureDevice> _captureDevice;
+    std::unique_ptr<mvIMPACT::acquire::SettingsBlueFOX> _settings;
+    std::map<std::string, std::function<bool(const std::string &)>> _settingHandlers;
+    PropertyWriteBatch _propertyWrites;
+    std::unique_ptr<ExposureController> _exposureController;
+    std::mutex _recorderMutex;
+    std::unique_ptr<webcam::FrameRecorder> _recorder;
+    template<typename _Ty>
+    void addSetting(const std::string &key, const _Ty &prop);
+    // applies the config's settings to the open device, again on every reopen
+    void configureDevice();
+    bool writeSetting(const std::string &key, const std::string &value);
+    void createExposureController();
 
-    std::unique_ptr<RequestProvider> _requestProvider;
-    std::unique_ptr<FunctionInterface> _functionInterface;
-    webcam::Webcam _webcam;
+    // sensor AOI/binning matching what the pipeline uses, unless the config sets them
+    void programSensorRegion();
+    bool isConfigured(const std::string &keyPrefix) const;
+    void updateBinning();
+    std::atomic<int> _binningX{1};
+    std::atomic<int> _binningY{1};
+    // cheaper bayerConversionMode while the Webcam gives up QualityStep::Demosaic, capture thread only
+    void updateDemosaic();
+    bool _cheapDemosaic{false};
+    static constexpr const char *cheapDemosaicMode{"Linear Interpolation"};
+    // the mode to go back to, the config's or else the driver's, read by configureDevice()
+    std::string _demosaicMode;
+    // false when there is nothing cheaper to switch to
+    bool demosaicStep() const;
+    // requests CameraConfig::sensorFormat, returns what the device delivers
+    webcam::SensorFormat negotiateSensorFormat();
+    // created once the device is open and the sensor format is known
+    std::unique_ptr<webcam::Webcam> _webcam;
+    // after the Webcam, its capture thread publishes there. Pauses the acquisition while nobody reads
+    // the output devices and recovers from stalls, see CaptureWatchdog
+    std::unique_ptr<webcam::CaptureWatchdog> _watchdog;
 };
 
 }
\ No newline at end of file
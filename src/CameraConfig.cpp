@@ -0,0 +1,352 @@
+#include "CameraConfig.hpp"
+#include "Undistortion.hpp"
+#include "Webcam.hpp"
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <cstdlib>
+#include <algorithm>
+#include <strings.h>
+
+namespace webcam::Driver {
+
+namespace {
+
+std::string trim(const std::string &text) {
+    const auto begin = text.find_first_not_of(" \t\r");
+    if (begin == std::string::npos)
+    {
+        return "";
+    }
+    const auto end = text.find_last_not_of(" \t\r");
+    return text.substr(begin, end - begin + 1);
+}
+
+unsigned int toUnsigned(const std::string &key, const std::string &value) {
+    try
+    {
+        const long number = std::stol(value);
+        if (number > 0)
+        {
+            return static_cast<unsigned int>(number);
+        }
+    }
+    catch (const std::exception &)
+    {
+    }
+    throw std::runtime_error("Config value for '" + key + "' has to be a positive number");
+}
+
+bool toBool(const std::string &key, const std::string &value) {
+    for (const char *on : {"on", "true", "1"})
+    {
+        if (strcasecmp(value.c_str(), on) == 0)
+        {
+            return true;
+        }
+    }
+    for (const char *off : {"off", "false", "0"})
+    {
+        if (strcasecmp(value.c_str(), off) == 0)
+        {
+            return false;
+        }
+    }
+    throw std::runtime_error("Config value for '" + key + "' has to be On or Off");
+}
+
+PixelFormat toPixelFormat(const std::string &key, const std::string &value) {
+    if (strcasecmp(value.c_str(), "YUYV") == 0)
+    {
+        return PixelFormat::YUYV;
+    }
+    if (strcasecmp(value.c_str(), "MJPEG") == 0)
+    {
+        return PixelFormat::MJPEG;
+    }
+    throw std::runtime_error("Config value for '" + key + "' has to be YUYV or MJPEG");
+}
+
+webcam::SensorFormat toSensorFormat(const std::string &key, const std::string &value) {
+    if (strcasecmp(value.c_str(), "Mono8") == 0)
+    {
+        return webcam::SensorFormat::Mono8;
+    }
+    if (strcasecmp(value.c_str(), "YUV422") == 0)
+    {
+        return webcam::SensorFormat::YUV422;
+    }
+    if (strcasecmp(value.c_str(), "BGR888") == 0)
+    {
+        return webcam::SensorFormat::BGR888;
+    }
+    throw std::runtime_error("Config value for '" + key + "' has to be Mono8, YUV422 or BGR888");
+}
+
+}
+
+std::string CameraConfig::path(const std::string &serial) {
+    std::string dir;
+    if (const char *xdg = std::getenv("XDG_CONFIG_HOME"); xdg != nullptr && *xdg != '\0')
+    {
+        dir = xdg;
+    }
+    else if (const char *home = std::getenv("HOME"); home != nullptr)
+    {
+        dir = std::string(home) + "/.config";
+    }
+    else
+    {
+        dir = ".";
+    }
+    return dir + "/mvbluefox_webcam/" + serial + ".conf";
+}
+
+CameraConfig CameraConfig::load(const std::string &serial) {
+    CameraConfig config;
+    const std::string file = path(serial);
+    std::ifstream stream(file);
+    if (!stream)
+    {
+        std::cout << "No config file " << file << ", using defaults" << std::endl;
+        return config;
+    }
+
+    std::string line;
+    int lineNr = 0;
+    while (std::getline(stream, line))
+    {
+        lineNr++;
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty())
+        {
+            continue;
+        }
+        const auto separator = line.find('=');
+        if (separator == std::string::npos)
+        {
+            throw std::runtime_error(file + ":" + std::to_string(lineNr) + ": expected 'key = value'");
+        }
+        config.set(trim(line.substr(0, separator)), trim(line.substr(separator + 1)));
+    }
+    for (size_t i = 0; i < config.outputs.size(); i++)
+    {
+        for (size_t j = 0; j < i; j++)
+        {
+            if (config.outputs[i].device == config.outputs[j].device)
+            {
+                throw std::runtime_error(file + ": outputs " + std::to_string(j) + " and " + std::to_string(i)
+                                         + " both use " + config.outputs[i].device);
+            }
+        }
+    }
+    std::cout << "Loaded config " << file << std::endl;
+    return config;
+}
+
+void CameraConfig::set(const std::string &key, const std::string &value) {
+    // output<n>.<key> configures the additional outputs
+    const auto dot = key.find('.');
+    if (key.compare(0, 6, "output") == 0 && dot != std::string::npos)
+    {
+        const std::string index = key.substr(6, dot - 6);
+        if (index.empty() || index.find_first_not_of("0123456789") != std::string::npos || index.size() > 2)
+        {
+            throw std::runtime_error("Config key '" + key + "' needs an output number, e.g. output1." + key.substr(dot + 1));
+        }
+        const size_t outputIndex = std::stoul(index);
+        if (outputs.size() <= outputIndex)
+        {
+            outputs.resize(outputIndex + 1);
+        }
+        if (!setOutput(outputs[outputIndex], key.substr(dot + 1), value))
+        {
+            throw std::runtime_error("Unknown output config key '" + key + "'");
+        }
+    }
+    else if (key == "sensorFormat")
+    {
+        sensorFormat = toSensorFormat(key, value);
+    }
+    else if (key == "hostExposureControl")
+    {
+        hostExposureControl = toBool(key, value);
+    }
+    else if (key == "temporalDenoise")
+    {
+        temporalDenoise = value == "0" ? 0 : toUnsigned(key, value);
+        if (temporalDenoise > 95)
+        {
+            throw std::runtime_error("Config value for '" + key + "' has to be 0 to 95");
+        }
+    }
+    else if (key == "shadingMap")
+    {
+        shadingMap = value;
+    }
+    else if (key == "colorLut")
+    {
+        colorLut = value;
+    }
+    else if (key == "colorMatrix" || key == "colorGamma")
+    {
+        try
+        {
+            if (key == "colorMatrix")
+            {
+                colorMatrix = webcam::ColorTransform::parseMatrix(value);
+            }
+            else
+            {
+                colorGamma = webcam::ColorTransform::parseGamma(value);
+            }
+        }
+        catch (const std::invalid_argument &e)
+        {
+            throw std::runtime_error("Config value for '" + key + "' " + e.what());
+        }
+    }
+    else if (key == "qualitySteps")
+    {
+        try
+        {
+            qualitySteps = webcam::QualityController::parseSteps(value);
+        }
+        catch (const std::invalid_argument &e)
+        {
+            throw std::runtime_error("Config value for '" + key + "' " + e.what());
+        }
+    }
+    else if (key == "captureScheduling" || key == "captureCpus")
+    {
+        try
+        {
+            if (key == "captureScheduling")
+            {
+                captureScheduling.policy = webcam::ThreadScheduling::parsePolicy(value);
+            }
+            else
+            {
+                captureScheduling.cpus = webcam::ThreadScheduling::parseCpus(value);
+            }
+        }
+        catch (const std::invalid_argument &e)
+        {
+            throw std::runtime_error("Config value for '" + key + "' " + e.what());
+        }
+    }
+    else if (key == "capturePriority")
+    {
+        captureScheduling.priority = static_cast<int>(toUnsigned(key, value));
+    }
+    else if (!setOutput(outputs.front(), key, value))
+    {
+        explicitSettings.insert(key);
+        auto existing = std::find_if(cameraSettings.begin(), cameraSettings.end(),
+                                     [&key](const auto &setting) { return setting.first == key; });
+        if (existing != cameraSettings.end())
+        {
+            existing->second = value;
+        }
+        else
+        {
+            cameraSettings.emplace_back(key, value);
+        }
+    }
+}
+
+bool CameraConfig::setOutput(OutputConfig &output, const std::string &key, const std::string &value) {
+    if (key == "device")
+    {
+        output.device = value;
+    }
+    else if (key == "width")
+    {
+        output.width = toUnsigned(key, value);
+    }
+    else if (key == "height")
+    {
+        output.height = toUnsigned(key, value);
+    }
+    else if (key == "fps")
+    {
+        output.framesPerSecond = toUnsigned(key, value);
+    }
+    else if (key == "format")
+    {
+        output.format = toPixelFormat(key, value);
+    }
+    else if (key == "jpegQuality")
+    {
+        output.jpegQuality = static_cast<int>(toUnsigned(key, value));
+        if (output.jpegQuality > 100)
+        {
+            throw std::runtime_error("Config value for '" + key + "' has to be 1 to 100");
+        }
+    }
+    else if (key == "jpegThreads")
+    {
+        output.jpegThreads = toUnsigned(key, value);
+    }
+    else if (key == "jpegBitrate_kbps")
+    {
+        // 0 turns the rate control off
+        output.jpegBitrate_kbps = value == "0" ? 0 : toUnsigned(key, value);
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+unsigned int CameraConfig::maxFramesPerSecond() const {
+    unsigned int framesPerSecond = 0;
+    for (const auto &output : outputs)
+    {
+        framesPerSecond = std::max(framesPerSecond, output.framesPerSecond);
+    }
+    return framesPerSecond;
+}
+
+void CameraConfig::configure(webcam::Webcam &webcam, const std::string &name, bool demosaicStep) const {
+    webcam.setDenoiseStrength(static_cast<int>(temporalDenoise));
+    if (!shadingMap.empty())
+    {
+        webcam.setShading(webcam::Undistortion::loadShading(shadingMap));
+    }
+    std::shared_ptr<const webcam::ColorTransform> color;
+    if (!colorLut.empty())
+    {
+        color = webcam::ColorTransform::loadCube(colorLut);
+    }
+    else if (colorMatrix != webcam::ColorTransform::identityMatrix || colorGamma != webcam::ColorTransform::linearGamma)
+    {
+        color = webcam::ColorTransform::fromMatrix(colorMatrix, colorGamma);
+    }
+    if (color)
+    {
+        std::cout << name << ": color transform " << color->description() << std::endl;
+        webcam.setColorTransform(std::move(color));
+    }
+    std::vector<webcam::QualityStep> steps = qualitySteps;
+    if (!demosaicStep)
+    {
+        // giving it up would change nothing but still count as a level
+        steps.erase(std::remove(steps.begin(), steps.end(), webcam::QualityStep::Demosaic), steps.end());
+    }
+    webcam.setQualitySteps(steps, maxFramesPerSecond());
+}
+
+std::string CameraConfig::cameraSetting(const std::string &key) const {
+    for (const auto &setting : cameraSettings)
+    {
+        if (setting.first == key)
+        {
+            return setting.second;
+        }
+    }
+    return "";
+}
+
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <array>
+#include <set>
+#include <string>
+#include <vector>
+#include <utility>
+#include "OutputConfig.hpp"
+#include "RawFrame.hpp"
+#include "Realtime.hpp"
+#include "QualityController.hpp"
+#include "ColorTransform.hpp"
+
+namespace webcam {
+class Webcam;
+}
+
+namespace webcam::Driver {
+
+/// \brief Per camera settings, read from <config dir>/<serial>.conf
+///
+/// The file holds one "key = value" per line, '#' starts a comment. The keys
+/// device, width, height, fps, format, jpegQuality, jpegThreads, jpegBitrate_kbps
+/// configure output 0, prefixed with output<n>. they configure additional outputs
+/// fed from the same capture. These, sensorFormat, hostExposureControl, temporalDenoise, shadingMap, colorLut,
+/// colorMatrix, colorGamma, qualitySteps and the capture thread's captureScheduling, capturePriority and captureCpus configure the host side,
+/// every other key is a camera property (see Camera::applySetting). Keys missing in the file keep
+/// their defaults, a missing file means all defaults.
+/// The config dir is $XDG_CONFIG_HOME/mvbluefox_webcam or ~/.config/mvbluefox_webcam.
+class CameraConfig {
+public:
+    static CameraConfig load(const std::string &serial);
+    static std::string path(const std::string &serial);
+
+    // at least one, every output needs its own device
+    std::vector<OutputConfig> outputs{OutputConfig()};
+    // pixel format requested from the driver, the pipeline is specialized for it
+    webcam::SensorFormat sensorFormat{webcam::SensorFormat::BGR888};
+    // ExposureController instead of the camera's AEC/AGC and white balance preset
+    bool hostExposureControl{false};
+    // percentage of the previous frame kept in static areas, 0 is off (see TemporalDenoiser)
+    unsigned int temporalDenoise{0};
+    // flat field picture the lens shading correction is computed from, empty is off (see Undistortion::setShading)
+    std::string shadingMap;
+    // color correction while packing (see ColorTransform): a .cube file, or else a matrix and gamma if not the defaults
+    std::string colorLut;
+    std::array<double, 9> colorMatrix{webcam::ColorTransform::identityMatrix};
+    std::array<double, 3> colorGamma{webcam::ColorTransform::linearGamma};
+    // given up in this order while frames take longer than the frame interval, see QualityController
+    std::vector<webcam::QualityStep> qualitySteps{webcam::QualityStep::Sharpening, webcam::QualityStep::Detection,
+                                                  webcam::QualityStep::Demosaic, webcam::QualityStep::FrameRate};
+    // applied to the driver's capture thread, see ThreadScheduling
+    webcam::ThreadScheduling captureScheduling;
+
+    // camera properties, applied in this order
+    std::vector<std::pair<std::string, std::string>> cameraSettings{
+        {"exposeUpperLimit_us", "40000"},
+        {"gainUpperLimit_dB", "12.0"},
+        {"autoGainControl", "On"},
+        {"autoExposeControl", "On"},
+        {"offsetAutoCalibration", "On"},
+        {"bayerConversionMode", "Adaptive Edge Sensing Plus"},
+        {"whiteBalance", "Fluorescent"},
+    };
+    // the camera property keys the config file sets, the others above are defaults
+    std::set<std::string> explicitSettings;
+
+    /// \brief Value of a camera property setting, empty if there is none.
+    std::string cameraSetting(const std::string &key) const;
+
+    /// \brief Highest frame rate any output needs from the camera.
+    unsigned int maxFramesPerSecond() const;
+
+    /// \brief Sets up webcam's processing as configured here, for a camera and for a replay of its recording
+    /// alike. QualityStep::Demosaic is left out unless giving it up changes the driver's demosaicing.
+    /// name prefixes what gets logged.
+    void configure(webcam::Webcam &webcam, const std::string &name, bool demosaicStep) const;
+
+private:
+    void set(const std::string &key, const std::string &value);
+    static bool setOutput(OutputConfig &output, const std::string &key, const std::string &value);
+};
+
+}
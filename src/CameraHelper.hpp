@@ -1,6 +1,11 @@
 #pragma once
 #include <iostream>
 #include <vector>
+#include <string>
+#include <sstream>
+#include <algorithm>
+#include <type_traits>
+#include <strings.h>
 #include <mvIMPACT_CPP/mvIMPACT_acquire.h>
 
 void manuallyStopAcquisitionIfNeeded(mvIMPACT::acquire::Device *pDev, const mvIMPACT::acquire::FunctionInterface &fi);
@@ -46,6 +51,58 @@ public:
             }
         }
     }
+
+    /// \brief Sets a property from its textual representation (as in a config file) if the value is supported.
+    ///
+    /// Properties with a translation dictionary take one of the dictionary strings (case insensitive),
+    /// numeric properties take a number.
+    /// \return false if the property can't be written or the value isn't supported
+    template<typename _Ty>
+    static bool setPropertyFromString(const _Ty &prop, const std::string &text, bool boSilent = false) {
+        using value_type = typename _Ty::value_type;
+        if (!prop.isValid() || !prop.isWriteable())
+        {
+            return false;
+        }
+
+        value_type value{};
+        if (prop.hasDict())
+        {
+            typename std::vector<std::pair<std::string, value_type>> dict;
+            prop.getTranslationDict(dict);
+            const auto entry = std::find_if(dict.begin(), dict.end(), [&text](const auto &e) {
+                return strcasecmp(e.first.c_str(), text.c_str()) == 0;
+            });
+            if (entry == dict.end())
+            {
+                return false;
+            }
+            value = entry->second;
+        }
+        else if constexpr (!std::is_enum_v<value_type>)
+        {
+            std::istringstream stream(text);
+            if (!(stream >> value) || !stream.eof())
+            {
+                return false;
+            }
+        }
+        else
+        {
+            return false;
+        }
+
+        if (!supportsValue(prop, value))
+        {
+            return false;
+        }
+        prop.write(value);
+        if (!boSilent)
+        {
+            std::cout << "Property '" << prop.name() << "' set to '" << prop.readS() << "'." << std::endl;
+        }
+        return true;
+    }
 };
 
 }
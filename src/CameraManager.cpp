@@ -1,10 +1,26 @@
 #include "CameraManager.hpp"
+#include "ColorTransform.hpp"
+#include "Metrics.hpp"
+#include "Trace.hpp"
 #include <stdexcept>
 #include <iostream>
+#include <algorithm>
+#include <future>
+#include <thread>
+#include <sstream>
+#include <opencv2/core.hpp>
 
 namespace webcam::Driver {
 
-CameraManager::CameraManager() {
+CameraManager::CameraManager(const webcam::ThreadScheduling &processing, unsigned int threads, int bandRows)
+    : _threadPool(poolSize(threads), processing) {
+    // all per-pixel work is split up on our own pool, OpenCV's loops (face detection) run there as well
+    _threadPool.runOpenCvLoops();
+    std::cout << "Processing on " << _threadPool.threadCount() << " threads, " << bandRows << " rows per band"
+              << std::endl;
+    // shared by all cameras, loaded while the devices are opened
+    Undistortion::prepare();
+    FaceDetector::prepare();
 
     const unsigned int devCnt = _devMgr.deviceCount();
     if (devCnt == 0)
@@ -13,13 +29,169 @@ CameraManager::CameraManager() {
     }
     std::cout<<"Found "<<devCnt<<" devices"<<std::endl;
 
-    // display every device detected that matches
+    // opening a device takes a while, open them all at the same time
+    std::vector<std::future<std::unique_ptr<Camera>>> opening;
     for (unsigned int i = 0; i < devCnt; i++)
     {
         Device *dev = _devMgr[i];
-        _cameras.emplace_back(new Camera(dev));
+        opening.push_back(std::async(std::launch::async, [this, dev, bandRows] {
+            return std::make_unique<Camera>(dev, _threadPool, bandRows, _started);
+        }));
     }
+    for (auto &camera : opening)
+    {
+        _cameras.push_back(camera.get());
+    }
+
+}
 
+void CameraManager::handleCommand(const std::string &command) {
+    std::istringstream stream(command);
+    std::string verb;
+    if (!(stream >> verb))
+    {
+        return;
+    }
+
+    if (verb == "list")
+    {
+        for (const auto &camera : _cameras)
+        {
+            std::cout << camera->serial() << " (" << CameraConfig::path(camera->serial()) << ")" << std::endl;
+        }
+    }
+    else if (verb == "set")
+    {
+        std::string target;
+        std::string key;
+        std::string value;
+        stream >> target >> key >> std::ws;
+        std::getline(stream, value);
+        if (value.empty())
+        {
+            std::cout << "usage: set <serial|all> <key> <value>" << std::endl;
+            return;
+        }
+        bool found = false;
+        for (const auto &camera : _cameras)
+        {
+            if (target == "all" || target == camera->serial())
+            {
+                found = true;
+                camera->applySetting(key, value);
+            }
+        }
+        if (!found)
+        {
+            std::cout << "No camera with serial " << target << std::endl;
+        }
+    }
+    else if (verb == "metrics")
+    {
+        Metrics::global().print(std::cout);
+    }
+    else if (verb == "record")
+    {
+        std::string target;
+        std::string file;
+        stream >> target >> std::ws;
+        std::getline(stream, file);
+        if (file.empty())
+        {
+            std::cout << "usage: record <serial|all> <file|stop>" << std::endl;
+            return;
+        }
+        const bool several = target == "all" && _cameras.size() > 1;
+        bool found = false;
+        for (const auto &camera : _cameras)
+        {
+            if (target != "all" && target != camera->serial())
+            {
+                continue;
+            }
+            found = true;
+            if (file == "stop")
+            {
+                camera->stopRecording();
+                continue;
+            }
+            try
+            {
+                // one file per camera
+                camera->startRecording(several ? file + "." + camera->serial() : file);
+            }
+            catch (const std::exception &e)
+            {
+                std::cout << camera->serial() << ": " << e.what() << std::endl;
+            }
+        }
+        if (!found)
+        {
+            std::cout << "No camera with serial " << target << std::endl;
+        }
+    }
+    else if (verb == "trace")
+    {
+        std::string file;
+        stream >> std::ws;
+        std::getline(stream, file);
+        if (file.empty())
+        {
+            std::cout << "usage: trace <file>" << std::endl;
+            return;
+        }
+        if (Trace::dump(file))
+        {
+            std::cout << "Trace written to " << file << std::endl;
+        }
+        else
+        {
+            std::cout << "Cannot write trace to " << file << std::endl;
+        }
+    }
+    else if (verb == "color")
+    {
+        std::string target;
+        std::string file;
+        stream >> target >> std::ws;
+        std::getline(stream, file);
+        if (file.empty())
+        {
+            std::cout << "usage: color <serial|all> <file.cube|off>" << std::endl;
+            return;
+        }
+        // loaded once and shared, the cameras keep streaming meanwhile
+        std::shared_ptr<const webcam::ColorTransform> transform;
+        if (file != "off")
+        {
+            try
+            {
+                transform = webcam::ColorTransform::loadCube(file);
+            }
+            catch (const std::exception &e)
+            {
+                std::cout << e.what() << std::endl;
+                return;
+            }
+        }
+        bool found = false;
+        for (const auto &camera : _cameras)
+        {
+            if (target == "all" || target == camera->serial())
+            {
+                found = true;
+                camera->setColorTransform(transform);
+            }
+        }
+        if (!found)
+        {
+            std::cout << "No camera with serial " << target << std::endl;
+        }
+    }
+    else
+    {
+        std::cout << "Unknown command '" << verb << "', known: list, set, metrics, record, trace, color" << std::endl;
+    }
 }
 
-}
\ No newline at end of file
+}
@@ -1,7 +1,12 @@
 #pragma once
 #include <mvIMPACT_CPP/mvIMPACT_acquire.h>
+#include <algorithm>
+#include <chrono>
 #include <memory>
+#include <string>
+#include <thread>
 #include "Camera.hpp"
+#include "ThreadPool.hpp"
 
 using mvIMPACT::acquire::DeviceManager;
 
@@ -9,15 +14,39 @@ namespace webcam::Driver {
 
 class CameraManager {
 public:
-    CameraManager();
+    /// \param processing scheduling of the thread pool's workers, see ThreadScheduling
+    /// \param threads size of the thread pool, 0 is one per core
+    /// \param bandRows rows per work item when a frame is split up on the thread pool
+    explicit CameraManager(const webcam::ThreadScheduling &processing = {}, unsigned int threads = 0,
+                           int bandRows = defaultBandRows);
 
     CameraManager(const CameraManager &) = delete;
     CameraManager(CameraManager &&) = delete;
     CameraManager &operator=(const CameraManager &) = delete;
     CameraManager &operator=(CameraManager &&) = delete;
 
+    /// \brief Executes one line of the control interface:
+    /// - list
+    /// - set <serial|all> <key> <value>
+    /// - metrics
+    /// - record <serial|all> <file|stop>
+    /// - trace <file> (Chrome trace of the last few seconds, see Trace)
+    /// - color <serial|all> <file.cube|off> (see ColorTransform, swapped without stopping the stream)
+    void handleCommand(const std::string &command);
+
+    static constexpr int defaultBandRows{32};
+
+    /// \brief Thread pool size for threads, where 0 is one per core.
+    static unsigned int poolSize(unsigned int threads) {
+        return threads == 0 ? std::max(std::thread::hardware_concurrency(), 1u) : threads;
+    }
+
 private:
+    // before the device manager, enumerating the devices is part of the startup time
+    const std::chrono::steady_clock::time_point _started{std::chrono::steady_clock::now()};
     DeviceManager _devMgr;
+    // shared by all cameras for the per-frame processing
+    ThreadPool _threadPool;
     std::vector<std::unique_ptr<Camera>> _cameras;
 
 };
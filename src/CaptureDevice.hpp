@@ -0,0 +1,66 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include "RawFrame.hpp"
+
+namespace webcam {
+
+/// \brief A request the device finished, valid until it is unlocked.
+struct CaptureRequest {
+    int number{-1};
+    bool ok{false};
+    // what the driver reports for the request, e.g. why it failed
+    std::string result;
+    // offsets in image pixels and no binning, only set if ok
+    RawFrame frame;
+    int64_t timestamp_us{0};
+    double expose_us{0};
+    double gain_dB{0};
+};
+
+/// \brief The part of a camera driver the capture thread talks to (see CaptureLoop).
+///
+/// Like mvIMPACT's FunctionInterface the device owns a fixed pool of requests:
+/// free ones are queued, the device fills them in order, the capture thread
+/// waits for the next finished one, processes it and unlocks it, so it can be
+/// queued again. Opening and closing go through here as well so the watchdog
+/// can reopen any device (see CaptureWatchdog), configuring stays with the backend.
+class CaptureDevice {
+public:
+    virtual ~CaptureDevice() = default;
+
+    /// \brief Opens the device, all requests are free afterwards. Does nothing if it is open.
+    /// \throws std::runtime_error if the device can't be opened
+    virtual void open() = 0;
+
+    /// \brief Closes the device, nothing but open() works until it is opened again.
+    virtual void close() = 0;
+
+    /// \brief False after close() and once the device got lost.
+    virtual bool isOpen() const = 0;
+
+    /// \brief Hands a free request to the device to be filled.
+    /// \param number set to the number of the request that was queued
+    /// \return false if there is no free request or the device is gone
+    virtual bool queueRequest(int &number) = 0;
+
+    /// \brief Waits at most timeout for the next finished request.
+    /// \return false on timeout
+    virtual bool waitForRequest(std::chrono::milliseconds timeout, CaptureRequest &request) = 0;
+
+    /// \brief Makes a finished request free again, its frame data is no longer valid.
+    virtual void unlockRequest(int number) = 0;
+
+    /// \brief Drops all queued and finished requests, every request is free afterwards.
+    virtual void resetRequests() = 0;
+
+    /// \brief Starts and stops the sensor for devices that don't do it on the first queued request.
+    virtual void startAcquisition() {
+    }
+
+    virtual void stopAcquisition() {
+    }
+};
+
+}
@@ -0,0 +1,66 @@
+#include "CaptureLoop.hpp"
+#include "Metrics.hpp"
+#include "Trace.hpp"
+#include <stdexcept>
+
+namespace webcam {
+
+CaptureLoop::CaptureLoop(CaptureDevice &device, const std::string &name)
+    : _device(device), _timeouts(Metrics::global().counter(name + ".capture.timeouts")) {
+}
+
+CaptureLoop::~CaptureLoop() {
+    stop();
+}
+
+void CaptureLoop::start(Callback callback) {
+    if (_thread.joinable())
+    {
+        throw std::logic_error("capture thread is running already");
+    }
+    _run = true;
+    _thread = std::thread([this, callback = std::move(callback)] { captureMain(callback); });
+}
+
+void CaptureLoop::stop() {
+    _run = false;
+    if (_thread.joinable())
+    {
+        _thread.join();
+    }
+}
+
+void CaptureLoop::captureMain(const Callback &callback) {
+    // leftovers of the last run
+    _device.resetRequests();
+    int queued;
+    while (_device.queueRequest(queued))
+    {
+        TRACE_INSTANT("request queued", queued);
+    }
+    _device.startAcquisition();
+
+    CaptureRequest request;
+    while (_run)
+    {
+        if (!_device.waitForRequest(waitTimeout, request))
+        {
+            _timeouts++;
+            continue;
+        }
+        TRACE_INSTANT("request dequeued", request.number);
+        callback(request);
+        _device.unlockRequest(request.number);
+        TRACE_INSTANT("request unlocked", request.number);
+        // usually the one just unlocked, but that's up to the device
+        if (_device.queueRequest(queued))
+        {
+            TRACE_INSTANT("request queued", queued);
+        }
+    }
+
+    _device.stopAcquisition();
+    _device.resetRequests();
+}
+
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include "CaptureDevice.hpp"
+
+namespace webcam {
+
+/// \brief The capture thread of a CaptureDevice, the counterpart of mvIMPACT's RequestProvider.
+///
+/// start() queues every free request and calls the callback on a thread of
+/// its own for each finished one. The request is unlocked and queued again
+/// when the callback returns. stop() ends the thread and resets the requests.
+class CaptureLoop {
+public:
+    using Callback = std::function<void(const CaptureRequest &)>;
+
+    /// \param name prefix of the metrics, e.g. the camera's serial
+    CaptureLoop(CaptureDevice &device, const std::string &name);
+    ~CaptureLoop();
+
+    CaptureLoop(const CaptureLoop &) = delete;
+    CaptureLoop(CaptureLoop &&) = delete;
+    CaptureLoop &operator=(const CaptureLoop &) = delete;
+    CaptureLoop &operator=(CaptureLoop &&) = delete;
+
+    /// \throws std::logic_error if the thread is running already
+    void start(Callback callback);
+
+    /// \brief Returns once the thread is gone, does nothing if it isn't running.
+    void stop();
+
+    bool running() const {
+        return _thread.joinable();
+    }
+
+private:
+    // as RequestProvider, the thread notices stop() within this
+    static constexpr std::chrono::milliseconds waitTimeout{200};
+
+    CaptureDevice &_device;
+    std::atomic<bool> _run{false};
+    std::thread _thread;
+    std::atomic<unsigned long> &_timeouts;
+
+    void captureMain(const Callback &callback);
+};
+
+}
@@ -0,0 +1,196 @@
+#include "CaptureWatchdog.hpp"
+#include "Metrics.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+namespace webcam {
+
+namespace {
+
+std::chrono::steady_clock::duration stallTimeout(std::chrono::seconds minimum, int frames, double framesPerSecond) {
+    using namespace std::chrono;
+    if (framesPerSecond <= 0)
+    {
+        throw std::invalid_argument("frame rate has to be positive");
+    }
+    const duration<double> framesTime(frames / framesPerSecond);
+    return std::max<steady_clock::duration>(minimum, duration_cast<steady_clock::duration>(framesTime));
+}
+
+}
+
+CaptureWatchdog::CaptureWatchdog(CaptureDevice &device, const std::string &name, double framesPerSecond,
+                                 Handlers handlers)
+    : _device(device), _name(name), _stallTimeout(stallTimeout(minStallTimeout, stallFrames, framesPerSecond)),
+      _handlers(std::move(handlers)), _captureLoop(device, name) {
+    _thread = std::thread(&CaptureWatchdog::watchdogMain, this);
+}
+
+CaptureWatchdog::~CaptureWatchdog() {
+    {
+        std::lock_guard<std::mutex> lock(_wakeMutex);
+        _shouldRun = false;
+    }
+    _wake.notify_all();
+    _thread.join();
+    setRunning(false);
+}
+
+void CaptureWatchdog::setRunning(bool run) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (run == _running)
+    {
+        return;
+    }
+    _running = run;
+    if (run)
+    {
+        // the watchdog counts from here, a pause isn't a stall
+        _lastGoodFrame = std::chrono::steady_clock::now().time_since_epoch().count();
+        startCapture();
+    }
+    else
+    {
+        _captureLoop.stop();
+    }
+}
+
+void CaptureWatchdog::startCapture() {
+    // not after a failed reopen, the watchdog tries again
+    if (!_deviceReady)
+    {
+        return;
+    }
+    // before the capture thread exists
+    if (_handlers.starting)
+    {
+        _handlers.starting();
+    }
+    _captureLoop.start([this](const CaptureRequest &request) {
+        if (request.ok)
+        {
+            _lastGoodFrame = std::chrono::steady_clock::now().time_since_epoch().count();
+        }
+        _handlers.request(request);
+    });
+}
+
+void CaptureWatchdog::watchdogMain() {
+    TRACE_THREAD_NAME("watchdog " + _name);
+    std::unique_lock<std::mutex> lock(_wakeMutex);
+    while (!_wake.wait_for(lock, watchdogPeriod, [this] { return !_shouldRun; }))
+    {
+        lock.unlock();
+        checkCapture();
+        lock.lock();
+    }
+}
+
+void CaptureWatchdog::checkCapture() {
+    using namespace std::chrono;
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_running)
+    {
+        // paused, no frames expected
+        return;
+    }
+    const auto now = steady_clock::now();
+    const steady_clock::time_point lastGoodFrame{steady_clock::duration(_lastGoodFrame.load())};
+    auto &metrics = Metrics::global();
+    if (now - lastGoodFrame < _stallTimeout)
+    {
+        if (_recovery != Recovery::None)
+        {
+            // time without frames, up to the first new one
+            const double outage_ms = duration<double, std::milli>(lastGoodFrame - _stallStarted).count();
+            metrics.gauge(_name + ".watchdog.lastOutage_ms") = outage_ms;
+            auto &maxOutage = metrics.gauge(_name + ".watchdog.maxOutage_ms");
+            maxOutage = std::max(maxOutage.load(), outage_ms);
+            std::cout << _name << ": frames again after " << outage_ms << " ms" << std::endl;
+            _recovery = Recovery::None;
+        }
+        return;
+    }
+
+    if (_recovery == Recovery::None)
+    {
+        _stallStarted = lastGoodFrame;
+        metrics.counter(_name + ".watchdog.stalls")++;
+        std::cout << _name << ": no frames for " << duration_cast<milliseconds>(now - lastGoodFrame).count()
+                  << " ms, recovering" << std::endl;
+        if (_handlers.stalled)
+        {
+            _handlers.stalled();
+        }
+    }
+    else if (now - _recoveryStepTime < (_recovery == Recovery::Reopened ? reopenRetryTime : recoveryStepTime))
+    {
+        return;
+    }
+
+    // each step gets recoveryStepTime to bring frames back before the next, heavier one
+    switch (_recovery)
+    {
+        case Recovery::None:
+            requeueRequests();
+            _recovery = Recovery::Requeued;
+            break;
+        case Recovery::Requeued:
+            std::cout << _name << ": resetting the request queue" << std::endl;
+            metrics.counter(_name + ".watchdog.resets")++;
+            // ending the capture thread resets the queue, starting it queues every request again
+            _captureLoop.stop();
+            startCapture();
+            _recovery = Recovery::Reset;
+            break;
+        case Recovery::Reset:
+        case Recovery::Reopened:
+            reopenDevice();
+            _recovery = Recovery::Reopened;
+            break;
+    }
+    _recoveryStepTime = now;
+}
+
+void CaptureWatchdog::requeueRequests() {
+    // requests the driver lost track of, the ones it still has are refused
+    int queued = 0;
+    int number;
+    while (_device.queueRequest(number))
+    {
+        TRACE_INSTANT("request queued", number);
+        queued++;
+    }
+    Metrics::global().counter(_name + ".watchdog.requeues")++;
+    std::cout << _name << ": queued " << queued << " requests again" << std::endl;
+}
+
+void CaptureWatchdog::reopenDevice() {
+    std::cout << _name << ": reopening the device" << std::endl;
+    Metrics::global().counter(_name + ".watchdog.reopens")++;
+    _captureLoop.stop();
+    _deviceReady = false;
+    try
+    {
+        if (_handlers.closing)
+        {
+            _handlers.closing();
+        }
+        _device.close();
+        _device.open();
+        if (_handlers.reopened)
+        {
+            _handlers.reopened();
+        }
+        _deviceReady = true;
+        startCapture();
+    }
+    catch (const std::exception &e)
+    {
+        std::cout << _name << ": reopening failed (" << e.what() << "), trying again" << std::endl;
+    }
+}
+
+}
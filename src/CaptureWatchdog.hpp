@@ -0,0 +1,95 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "CaptureLoop.hpp"
+
+namespace webcam {
+
+/// \brief Runs the CaptureLoop of a device while frames are wanted and gets them back when they stop.
+///
+/// Without a good request for stallFrames frame intervals (at least
+/// minStallTimeout) it escalates from queueing the requests again over
+/// restarting the capture thread to closing and reopening the device, giving
+/// each step recoveryStepTime to work and a reopen reopenRetryTime. A pause
+/// (setRunning(false)) isn't a stall. The device has to be open when the
+/// watchdog is created, the capture starts with setRunning(true).
+class CaptureWatchdog {
+public:
+    struct Handlers {
+        // every request, on the capture thread
+        CaptureLoop::Callback request;
+        // before a capture thread is started
+        std::function<void()> starting;
+        // once per stall, e.g. to show the consumers something
+        std::function<void()> stalled;
+        // around a reopen, the capture thread is gone already. If reopened throws the device counts
+        // as not reopened and the watchdog tries again.
+        std::function<void()> closing;
+        std::function<void()> reopened;
+    };
+
+    /// \param name prefix of the log and the metrics, e.g. the camera's serial
+    /// \param framesPerSecond frame rate the device runs at, the stall timeout depends on it
+    CaptureWatchdog(CaptureDevice &device, const std::string &name, double framesPerSecond, Handlers handlers);
+    /// \brief Ends the watchdog and the capture, the device stays open.
+    ~CaptureWatchdog();
+
+    CaptureWatchdog(const CaptureWatchdog &) = delete;
+    CaptureWatchdog(CaptureWatchdog &&) = delete;
+    CaptureWatchdog &operator=(const CaptureWatchdog &) = delete;
+    CaptureWatchdog &operator=(CaptureWatchdog &&) = delete;
+
+    /// \brief Starts or pauses the capture, e.g. as consumers come and go.
+    void setRunning(bool run);
+
+    /// \brief Keeps the watchdog from touching the device while held, e.g. while writing settings.
+    /// The handlers are called with it held.
+    std::unique_lock<std::mutex> lock() {
+        return std::unique_lock<std::mutex>(_mutex);
+    }
+
+private:
+    static constexpr std::chrono::milliseconds watchdogPeriod{100};
+    static constexpr std::chrono::seconds minStallTimeout{1};
+    static constexpr int stallFrames{10};
+    static constexpr std::chrono::seconds recoveryStepTime{1};
+    static constexpr std::chrono::seconds reopenRetryTime{5};
+    enum class Recovery {
+        None, Requeued, Reset, Reopened
+    };
+
+    CaptureDevice &_device;
+    const std::string _name;
+    const std::chrono::steady_clock::duration _stallTimeout;
+    const Handlers _handlers;
+    CaptureLoop _captureLoop;
+
+    // steady_clock ticks of the last good request, set by the capture thread
+    std::atomic<std::chrono::steady_clock::rep> _lastGoodFrame{0};
+    // the rest with _mutex held
+    std::mutex _mutex;
+    bool _running{false};
+    // false after a failed reopen until one works
+    bool _deviceReady{true};
+    Recovery _recovery{Recovery::None};
+    std::chrono::steady_clock::time_point _stallStarted;
+    std::chrono::steady_clock::time_point _recoveryStepTime;
+
+    std::thread _thread;
+    std::mutex _wakeMutex;
+    std::condition_variable _wake;
+    bool _shouldRun{true};
+
+    void startCapture();
+    void watchdogMain();
+    void checkCapture();
+    void requeueRequests();
+    void reopenDevice();
+};
+
+}
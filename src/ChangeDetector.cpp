@@ -0,0 +1,57 @@
+#include "ChangeDetector.hpp"
+#include <opencv2/imgproc.hpp>
+
+namespace webcam {
+
+void ChangeDetector::update(const cv::Mat &image) {
+    // area averaging with an integer factor, the cheap way to get a clean small image
+    const cv::Size smallSize(image.cols / downscale, image.rows / downscale);
+    if (image.channels() == 1)
+    {
+        cv::resize(image, _luma, smallSize, 0, 0, cv::INTER_AREA);
+    }
+    else
+    {
+        cv::resize(image, _small, smallSize, 0, 0, cv::INTER_AREA);
+        cv::cvtColor(_small, _luma, cv::COLOR_BGRA2GRAY);
+    }
+    compare();
+}
+
+void ChangeDetector::markReference() {
+    _luma.copyTo(_reference);
+    compare();
+}
+
+void ChangeDetector::compare() {
+    if (_reference.size() != _luma.size())
+    {
+        _changedBlocks.release();
+        return;
+    }
+    cv::absdiff(_luma, _reference, _difference);
+    // the block means, again by area averaging
+    cv::resize(_difference, _blockMeans, cv::Size(_difference.cols / blockSize, _difference.rows / blockSize), 0, 0,
+               cv::INTER_AREA);
+    cv::compare(_blockMeans, blockThreshold, _changedBlocks, cv::CMP_GT);
+}
+
+bool ChangeDetector::changed(const cv::Rect &region) const {
+    if (_changedBlocks.empty())
+    {
+        return true;
+    }
+    if (cv::countNonZero(_changedBlocks) > frameThreshold * static_cast<double>(_changedBlocks.total()))
+    {
+        return true;
+    }
+
+    constexpr int blockPixels = downscale * blockSize;
+    const cv::Rect blocks = cv::Rect(cv::Point(region.x / blockPixels, region.y / blockPixels),
+                                     cv::Point((region.x + region.width + blockPixels - 1) / blockPixels,
+                                               (region.y + region.height + blockPixels - 1) / blockPixels))
+                            & cv::Rect(0, 0, _changedBlocks.cols, _changedBlocks.rows);
+    return blocks.area() > 0 && cv::countNonZero(_changedBlocks(blocks)) > 0;
+}
+
+}
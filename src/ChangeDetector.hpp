@@ -0,0 +1,42 @@
+#pragma once
+#include <opencv2/core.hpp>
+
+namespace webcam {
+
+/// \brief Cheap test whether a scene changed since a reference frame.
+///
+/// Works on the luma of the frame downscaled by 8, compared block by block
+/// (32x32 frame pixels) with the mean absolute difference. The downscale
+/// averages away sensor noise, so the thresholds hold at any gain.
+class ChangeDetector {
+public:
+    /// \brief Takes the current frame (BGRA or gray), call before changed()/markReference().
+    void update(const cv::Mat &image);
+
+    /// \brief True if a block overlapping region (frame pixels) or a sizeable part of the frame changed
+    /// since the last markReference(), or if there is no reference yet.
+    bool changed(const cv::Rect &region) const;
+
+    /// \brief The frame passed to the last update() becomes the reference.
+    void markReference();
+
+private:
+    static constexpr int downscale{8};
+    // in downscaled pixels
+    static constexpr int blockSize{4};
+    // mean absolute luma difference of a block that counts as a change
+    static constexpr double blockThreshold{6};
+    // part of all blocks that has to change when the face window itself didn't
+    static constexpr double frameThreshold{0.1};
+
+    cv::Mat _luma;
+    cv::Mat _reference;
+    // scratch, kept so it is allocated once
+    cv::Mat _small;
+    cv::Mat _difference;
+    cv::Mat _blockMeans;
+    cv::Mat _changedBlocks;
+    void compare();
+};
+
+}
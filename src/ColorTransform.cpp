@@ -0,0 +1,210 @@
+#include "ColorTransform.hpp"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace webcam {
+
+namespace {
+
+// .cube files may have up to 256 points per axis, more than 65 only costs cache misses
+constexpr int maxCubeSize = 65;
+
+std::vector<double> parseNumbers(std::string text) {
+    std::replace(text.begin(), text.end(), ',', ' ');
+    std::istringstream stream(text);
+    std::vector<double> numbers;
+    double number;
+    while (stream >> number)
+    {
+        numbers.push_back(number);
+    }
+    if (!stream.eof())
+    {
+        numbers.clear();
+    }
+    return numbers;
+}
+
+}
+
+ColorTransform::ColorTransform(int size, std::string description)
+    : _size(size), _table(4 * static_cast<size_t>(size) * size * size, 0), _positions(256),
+      _curves(3 * ColorLut::curveSize), _description(std::move(description)) {
+    for (int value = 0; value < 256; value++)
+    {
+        // in 1/256 of a cell, the last value lies at the far end of the last cell
+        const int position = (value * (size - 1) * 256 + 127) / 255;
+        const int index = std::min(position >> 8, size - 2);
+        _positions[value] = static_cast<uint16_t>(index * 512 + position - index * 256);
+    }
+    setCurves(linearGamma);
+}
+
+void ColorTransform::setCurves(const std::array<double, 3> &gamma) {
+    for (int channel = 0; channel < 3; channel++)
+    {
+        // B, G, R like the pixels
+        const double exponent = 1 / gamma[2 - channel];
+        for (int step = 0; step < ColorLut::curveSize; step++)
+        {
+            // the kernel truncates to a step, so integer levels come out unchanged without gamma
+            const double level = static_cast<double>(step) / ColorLut::curveSteps;
+            _curves[channel * ColorLut::curveSize + step] = static_cast<uint8_t>(
+                    std::min(255L, std::lround(255 * std::pow(level / 255, exponent))));
+        }
+    }
+}
+
+void ColorTransform::setEntry(int r, int g, int b, double red, double green, double blue) {
+    uint16_t *entry = &_table[4 * (r + _size * (g + static_cast<size_t>(_size) * b))];
+    const auto fixedPoint = [](double value) {
+        return static_cast<uint16_t>(std::lround(std::clamp(value, 0.0, 1.0) * 255 * 256));
+    };
+    entry[0] = fixedPoint(blue);
+    entry[1] = fixedPoint(green);
+    entry[2] = fixedPoint(red);
+}
+
+std::shared_ptr<const ColorTransform> ColorTransform::loadCube(const std::string &file) {
+    std::ifstream stream(file);
+    if (!stream)
+    {
+        throw std::runtime_error("Can't read " + file);
+    }
+    std::shared_ptr<ColorTransform> transform;
+    size_t entries = 0;
+    std::string line;
+    int lineNr = 0;
+    const auto fail = [&](const std::string &message) {
+        throw std::runtime_error(file + ":" + std::to_string(lineNr) + ": " + message);
+    };
+    while (std::getline(stream, line))
+    {
+        lineNr++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream words(line);
+        std::string keyword;
+        if (!(words >> keyword))
+        {
+            continue;
+        }
+        if (keyword == "TITLE")
+        {
+            continue;
+        }
+        if (keyword == "LUT_3D_SIZE")
+        {
+            int size = 0;
+            words >> size;
+            if (size < 2 || size > maxCubeSize || transform)
+            {
+                fail("LUT_3D_SIZE has to be given once, 2 to " + std::to_string(maxCubeSize));
+            }
+            transform.reset(new ColorTransform(size, file));
+        }
+        else if (keyword == "LUT_1D_SIZE")
+        {
+            fail("1D LUTs are not supported");
+        }
+        else if (keyword == "DOMAIN_MIN" || keyword == "DOMAIN_MAX")
+        {
+            const std::vector<double> domain = parseNumbers(line.substr(line.find(keyword) + keyword.size()));
+            const double expected = keyword == "DOMAIN_MIN" ? 0 : 1;
+            if (domain.size() != 3 || std::any_of(domain.begin(), domain.end(), [expected](double value) {
+                return value != expected;
+            }))
+            {
+                fail("only the domain 0 to 1 is supported");
+            }
+        }
+        else
+        {
+            const std::vector<double> rgb = parseNumbers(line);
+            if (rgb.size() != 3)
+            {
+                fail("expected three numbers");
+            }
+            if (!transform)
+            {
+                fail("LUT_3D_SIZE has to come before the data");
+            }
+            const int size = transform->_size;
+            if (entries >= static_cast<size_t>(size) * size * size)
+            {
+                fail("more than LUT_3D_SIZE^3 entries");
+            }
+            const int r = static_cast<int>(entries % size);
+            const int g = static_cast<int>(entries / size % size);
+            const int b = static_cast<int>(entries / size / size);
+            transform->setEntry(r, g, b, rgb[0], rgb[1], rgb[2]);
+            entries++;
+        }
+    }
+    if (!transform || entries != static_cast<size_t>(transform->_size) * transform->_size * transform->_size)
+    {
+        throw std::runtime_error(file + ": expected LUT_3D_SIZE and LUT_3D_SIZE^3 entries");
+    }
+    return transform;
+}
+
+std::shared_ptr<const ColorTransform> ColorTransform::fromMatrix(const std::array<double, 9> &matrix,
+                                                                 const std::array<double, 3> &gamma) {
+    std::ostringstream description;
+    description << "matrix";
+    for (double value : matrix)
+    {
+        description << " " << value;
+    }
+    description << ", gamma " << gamma[0] << " " << gamma[1] << " " << gamma[2];
+
+    std::shared_ptr<ColorTransform> transform(new ColorTransform(lutSize, description.str()));
+    for (int b = 0; b < lutSize; b++)
+    {
+        for (int g = 0; g < lutSize; g++)
+        {
+            for (int r = 0; r < lutSize; r++)
+            {
+                const double in[3] = {r / (lutSize - 1.0), g / (lutSize - 1.0), b / (lutSize - 1.0)};
+                double out[3];
+                for (int c = 0; c < 3; c++)
+                {
+                    out[c] = matrix[3 * c] * in[0] + matrix[3 * c + 1] * in[1] + matrix[3 * c + 2] * in[2];
+                }
+                // clipped by setEntry()
+                transform->setEntry(r, g, b, out[0], out[1], out[2]);
+            }
+        }
+    }
+    transform->setCurves(gamma);
+    return transform;
+}
+
+std::array<double, 9> ColorTransform::parseMatrix(const std::string &text) {
+    const std::vector<double> numbers = parseNumbers(text);
+    if (numbers.size() != 9)
+    {
+        throw std::invalid_argument("has to be nine numbers, row by row");
+    }
+    std::array<double, 9> matrix;
+    std::copy(numbers.begin(), numbers.end(), matrix.begin());
+    return matrix;
+}
+
+std::array<double, 3> ColorTransform::parseGamma(const std::string &text) {
+    const std::vector<double> numbers = parseNumbers(text);
+    if ((numbers.size() != 1 && numbers.size() != 3)
+        || std::any_of(numbers.begin(), numbers.end(), [](double value) { return !(value > 0); }))
+    {
+        throw std::invalid_argument("has to be one or three positive numbers");
+    }
+    if (numbers.size() == 1)
+    {
+        return {{numbers[0], numbers[0], numbers[0]}};
+    }
+    return {{numbers[0], numbers[1], numbers[2]}};
+}
+
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "PixelKernels.hpp"
+
+namespace webcam {
+
+/// \brief Color correction of the published frames, applied by FramePipeline while packing them.
+///
+/// Whatever it was made from, it is a 3D LUT over RGB that PixelKernels::lutBGRA
+/// interpolates tetrahedrally, followed by a curve per channel. A .cube file is all
+/// LUT; of a matrix and gamma the LUT holds the matrix, which is linear and so
+/// interpolates exactly, and the curves hold the gamma, which is steep in the
+/// shadows. Instances are immutable, so one can be swapped in while frames are
+/// being processed with the old one.
+class ColorTransform {
+public:
+    /// \brief From a .cube file (as written by Resolve and most grading tools), 2 to 65
+    /// points per axis, domain 0 to 1.
+    /// \throws std::runtime_error if it can't be read or isn't a 3D LUT
+    static std::shared_ptr<const ColorTransform> loadCube(const std::string &file);
+
+    /// \brief rgb' = matrix * rgb (row major, RGB order, values 0 to 1), clipped, then each channel
+    /// raised to 1 / gamma, so gamma above 1 brightens the mid tones. Sampled into a LUT of lutSize points.
+    static std::shared_ptr<const ColorTransform> fromMatrix(const std::array<double, 9> &matrix,
+                                                            const std::array<double, 3> &gamma);
+
+    /// \brief Nine numbers, separated by commas or spaces.
+    static std::array<double, 9> parseMatrix(const std::string &text);
+    /// \brief One positive number for all channels or three for red, green and blue.
+    static std::array<double, 3> parseGamma(const std::string &text);
+
+    static constexpr std::array<double, 9> identityMatrix{{1, 0, 0, 0, 1, 0, 0, 0, 1}};
+    static constexpr std::array<double, 3> linearGamma{{1, 1, 1}};
+    // points per axis of the LUT fromMatrix() samples, about the size of L1, the clipping is off by a few levels
+    static constexpr int lutSize = 17;
+
+    /// \brief Points per axis.
+    int size() const {
+        return _size;
+    }
+
+    /// \brief The tables for PixelKernels::lutBGRA, valid as long as this instance.
+    ColorLut lut() const {
+        return ColorLut{_table.data(), _size, _positions.data(), _curves.data()};
+    }
+
+    /// \brief Where it came from, for messages.
+    const std::string &description() const {
+        return _description;
+    }
+
+private:
+    ColorTransform(int size, std::string description);
+
+    int _size;
+    std::vector<uint16_t> _table;
+    std::vector<uint16_t> _positions;
+    std::vector<uint8_t> _curves;
+    std::string _description;
+
+    void setEntry(int r, int g, int b, double red, double green, double blue);
+    void setCurves(const std::array<double, 3> &gamma);
+};
+
+}
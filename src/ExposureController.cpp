@@ -0,0 +1,94 @@
+#include "ExposureController.hpp"
+#include "CameraHelper.hpp"
+#include "Metrics.hpp"
+#include <algorithm>
+#include <cmath>
+
+using namespace std::chrono;
+
+namespace webcam::Driver {
+
+ExposureController::ExposureController(const std::string &name, mvIMPACT::acquire::SettingsBlueFOX &settings,
+                                       PropertyWriteBatch &writes, double maxExpose_us, double maxGain_dB)
+    : _writes(writes), _expose_us(settings.cameraSetting.expose_us), _gain_dB(settings.cameraSetting.gain_dB),
+      _redGain(settings.imageProcessing.getWBUserSetting(0).redGain),
+      _blueGain(settings.imageProcessing.getWBUserSetting(0).blueGain),
+      _maxExpose_us(maxExpose_us), _maxGain_dB(maxGain_dB), _nextUpdate(steady_clock::now()),
+      _convergingSince(steady_clock::now()),
+      _meanLumaMetric(Metrics::global().gauge(name + ".exposure.meanLuma")),
+      _convergenceMetric(Metrics::global().gauge(name + ".exposure.convergence_ms")),
+      _cpuMetric(Metrics::global().gauge(name + ".exposure.cpu_us")) {
+    CameraHelper::conditionalSetProperty(settings.cameraSetting.autoExposeControl, mvIMPACT::acquire::aecOff);
+    CameraHelper::conditionalSetProperty(settings.cameraSetting.autoGainControl, mvIMPACT::acquire::agcOff);
+    CameraHelper::conditionalSetProperty(settings.imageProcessing.whiteBalance, mvIMPACT::acquire::wbpUser1);
+
+    // write access and limits change with the auto modes
+    _expose_us.refresh();
+    _gain_dB.refresh();
+    _redGain.refresh();
+    _blueGain.refresh();
+
+    // continue from where the camera's own control left off
+    _exposure_us = _expose_us.property().read() * std::pow(10.0, _gain_dB.property().read() / 20.0);
+    _redGainValue = _redGain.property().read();
+    _blueGainValue = _blueGain.property().read();
+}
+
+void ExposureController::update(const FaceStatistics &statistics) {
+    const auto start = steady_clock::now();
+    if (statistics.samples == 0)
+    {
+        return;
+    }
+
+    double lumaSum = 0;
+    for (size_t i = 0; i < statistics.lumaHistogram.size(); i++)
+    {
+        lumaSum += static_cast<double>(i) * statistics.lumaHistogram[i];
+    }
+    const double meanLuma = lumaSum / statistics.samples;
+    _meanLumaMetric = meanLuma;
+
+    const double error = std::clamp(std::log2(targetLuma / std::max(meanLuma, 1.0)), -2.0, 2.0);
+    const bool converged = std::abs(error) < convergedError;
+    if (converged && !_converged)
+    {
+        _convergenceMetric = duration<double, std::milli>(start - _convergingSince).count();
+    }
+    else if (!converged && _converged)
+    {
+        _convergingSince = start;
+    }
+    _converged = converged;
+
+    // the camera needs a few frames to apply a change, don't correct the same error twice
+    if (start >= _nextUpdate)
+    {
+        _nextUpdate = start + updateInterval;
+
+        if (!converged)
+        {
+            // exposure first, gain only once the exposure time would cost frame rate;
+            // half a step at a time as the face moves and the metering follows
+            const double maxExposure_us = _maxExpose_us * std::pow(10.0, _maxGain_dB / 20.0);
+            _exposure_us = std::clamp(_exposure_us * std::pow(2.0, 0.5 * error), 1.0, maxExposure_us);
+            const double expose_us = std::min(_exposure_us, _maxExpose_us);
+            const double gain_dB = std::clamp(20.0 * std::log10(_exposure_us / expose_us), 0.0, _maxGain_dB);
+            _writes.set(_expose_us, _expose_us.clamp(static_cast<int>(expose_us)));
+            _writes.set(_gain_dB, _gain_dB.clamp(gain_dB));
+        }
+
+        // white balance drifts slowly, it shouldn't follow every shirt that comes into view
+        const double chromaSamples = statistics.samples / 2.0;
+        const double meanU = statistics.sumU / chromaSamples - 128.0;
+        const double meanV = statistics.sumV / chromaSamples - 128.0;
+        _blueGainValue = _blueGain.clamp(_blueGainValue * std::pow(2.0, -(meanU - targetU) / 256.0));
+        _redGainValue = _redGain.clamp(_redGainValue * std::pow(2.0, -(meanV - targetV) / 256.0));
+        _writes.set(_blueGain, _blueGainValue);
+        _writes.set(_redGain, _redGainValue);
+    }
+
+    _cpuMetric = statistics.cost_us + duration<double, std::micro>(steady_clock::now() - start).count();
+}
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <chrono>
+#include <atomic>
+#include <string>
+#include <mvIMPACT_CPP/mvIMPACT_acquire.h>
+#include "PropertyCache.hpp"
+#include "FramePipeline.hpp"
+
+namespace webcam::Driver {
+
+/// \brief Host side exposure, gain and white balance control on the face window.
+///
+/// Replaces the camera's AEC/AGC, which meters the whole frame and leaves
+/// backlit faces dark. Works on the FaceStatistics of the published frames and
+/// pushes at most one set of property writes per updateInterval through the
+/// PropertyWriteBatch, so the camera has time to apply a change before the
+/// next one is computed.
+class ExposureController {
+public:
+    /// \brief Switches the camera's AEC, AGC and white balance preset off.
+    /// \param maxExpose_us longest exposure time, gain up to maxGain_dB is only added beyond that
+    ExposureController(const std::string &name, mvIMPACT::acquire::SettingsBlueFOX &settings,
+                       PropertyWriteBatch &writes, double maxExpose_us, double maxGain_dB);
+
+    ExposureController(const ExposureController &) = delete;
+    ExposureController(ExposureController &&) = delete;
+    ExposureController &operator=(const ExposureController &) = delete;
+    ExposureController &operator=(ExposureController &&) = delete;
+
+    /// \brief Feeds the statistics of one frame, call from the capture thread.
+    void update(const FaceStatistics &statistics);
+
+private:
+    static constexpr double targetLuma{118};
+    // typical skin chroma (U, V minus 128), the face is balanced towards this instead of gray
+    static constexpr double targetU{-10};
+    static constexpr double targetV{14};
+    // |log2(mean luma / target)| below which exposure counts as converged
+    static constexpr double convergedError{0.1};
+    static constexpr std::chrono::milliseconds updateInterval{200};
+
+    PropertyWriteBatch &_writes;
+    CachedProperty<mvIMPACT::acquire::PropertyI> _expose_us;
+    CachedProperty<mvIMPACT::acquire::PropertyF> _gain_dB;
+    CachedProperty<mvIMPACT::acquire::PropertyF> _redGain;
+    CachedProperty<mvIMPACT::acquire::PropertyF> _blueGain;
+    const double _maxExpose_us;
+    const double _maxGain_dB;
+
+    double _exposure_us;
+    double _redGainValue;
+    double _blueGainValue;
+    std::chrono::steady_clock::time_point _nextUpdate;
+    bool _converged{false};
+    std::chrono::steady_clock::time_point _convergingSince;
+
+    std::atomic<double> &_meanLumaMetric;
+    std::atomic<double> &_convergenceMetric;
+    std::atomic<double> &_cpuMetric;
+};
+
+}
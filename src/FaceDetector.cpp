@@ -1,35 +1,95 @@
 #include "FaceDetector.hpp"
+#include <chrono>
 #include <exception>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
 
 using namespace cv;
 
 namespace webcam {
 
+std::shared_future<std::shared_ptr<const std::string>> FaceDetector::model() {
+    static std::mutex mutex;
+    static std::shared_future<std::shared_ptr<const std::string>> file;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!file.valid())
+    {
+        file = std::async(std::launch::async, [] {
+            const cv::String path = cv::samples::findFile("haarcascades/haarcascade_frontalface_alt2.xml");
+            std::ifstream stream(path, std::ios::binary);
+            std::ostringstream content;
+            if (!(stream && content << stream.rdbuf()))
+            {
+                throw std::runtime_error("unable to read " + path);
+            }
+            return std::make_shared<const std::string>(content.str());
+        }).share();
+    }
+    return file;
+}
+
+void FaceDetector::prepare() {
+    model();
+}
+
 FaceDetector::FaceDetector() {
-    cv::String face_cascade_name = cv::samples::findFile( "haarcascades/haarcascade_frontalface_alt2.xml" );
+    _loading = std::async(std::launch::async, [this, file = model()] {
+        cv::FileStorage storage(*file.get(), cv::FileStorage::READ | cv::FileStorage::MEMORY);
+        if (!_face_cascade.read(storage.getFirstTopLevelNode()))
+        {
+            throw std::runtime_error("unable to load the face cascade");
+        }
+    });
+}
 
-    if( !_face_cascade.load( face_cascade_name ) )
+bool FaceDetector::ready() {
+    if (_ready || !_loading.valid())
+    {
+        return _ready;
+    }
+    if (_loading.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+    {
+        return false;
+    }
+    try
+    {
+        _loading.get();
+        _ready = true;
+    }
+    catch (const std::exception &e)
     {
-        throw std::runtime_error("unable to load");
+        // the video still works, it just doesn't follow the face
+        std::cout << "Face detection disabled: " << e.what() << std::endl;
     }
+    return _ready;
 }
 
-Point FaceDetector::detectFace(cv::Mat & bgra) {
+std::vector<Face> FaceDetector::detectFaces(cv::Mat & image) {
     cv::Mat frame_gray;
-    cvtColor( bgra, frame_gray, COLOR_BGRA2GRAY);
-    equalizeHist( frame_gray, frame_gray );
-
-    //-- Detect faces
-    std::vector<Rect> faces;
-    _face_cascade.detectMultiScale( frame_gray, faces );
-    for(auto & face : faces)
+    if (image.channels() == 1)
     {
-        Point center( face.x + face.width/2, face.y + face.height/2 );
-
-        return center;
+        equalizeHist( image, frame_gray );
+    }
+    else
+    {
+        cvtColor( image, frame_gray, COLOR_BGRA2GRAY);
+        equalizeHist( frame_gray, frame_gray );
     }
 
-    return Point(0,0);
+    //-- Detect faces, with the weights the grouping keeps per rectangle as confidence
+    std::vector<Rect> boxes;
+    std::vector<int> rejectLevels;
+    std::vector<double> levelWeights;
+    _face_cascade.detectMultiScale( frame_gray, boxes, rejectLevels, levelWeights, 1.1, 3, 0, Size(), Size(), true );
+    std::vector<Face> faces;
+    faces.reserve(boxes.size());
+    for (size_t i = 0; i < boxes.size(); i++)
+    {
+        faces.push_back(Face{boxes[i], i < levelWeights.size() ? levelWeights[i] : 0.0});
+    }
+    return faces;
 }
 
-}
\ No newline at end of file
+}
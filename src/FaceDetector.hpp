@@ -1,17 +1,46 @@
 #pragma once
 #include <opencv2/opencv.hpp>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
 
 namespace webcam{
 
+/// \brief A face found in an image.
+struct Face {
+    // image pixels
+    cv::Rect box;
+    // score of the cascade's last stage, higher is more certain
+    double confidence;
+};
 
+/// \brief Finds the face the pipeline follows.
+///
+/// The cascade file is read once per process. Every detector parses its own
+/// classifier from that copy in the background, as a classifier keeps scratch
+/// data per image and can't be shared between cameras. Frames can be processed
+/// meanwhile, detectFaces() is only allowed once ready() returned true.
 class FaceDetector {
 public:
     FaceDetector();
 
-    cv::Point detectFace(cv::Mat&);
+    /// \brief Starts reading the cascade file in the background, call early during startup.
+    static void prepare();
+
+    /// \brief True once the classifier is loaded, never blocks. Stays false if loading failed.
+    bool ready();
+
+    /// \brief All faces in a BGRA or gray image, in the order the cascade found them.
+    std::vector<Face> detectFaces(cv::Mat&);
 private:
+    static std::shared_future<std::shared_ptr<const std::string>> model();
+
     cv::CascadeClassifier _face_cascade;
+    // after the classifier, destroying it waits for the loading to finish
+    std::future<void> _loading;
+    bool _ready{false};
 };
 
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,155 @@
+#include "FaceFraming.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace webcam {
+
+namespace {
+
+cv::Point2d center(const cv::Rect2d &box) {
+    return {box.x + box.width / 2, box.y + box.height / 2};
+}
+
+}
+
+FaceFraming::FaceFraming(cv::Size imageSize, int minWindowSize)
+    : _imageSize(imageSize), _minWindowSize(minWindowSize),
+      _targetCenter(imageSize.width / 2.0, imageSize.height / 2.0), _targetSize(minWindowSize),
+      _center(_targetCenter), _size(minWindowSize) {
+    if (minWindowSize <= 0 || minWindowSize > std::min(imageSize.width, imageSize.height))
+    {
+        throw std::invalid_argument("window doesn't fit into the image");
+    }
+}
+
+void FaceFraming::update(const std::vector<Face> &faces) {
+    std::vector<bool> matched(_tracks.size(), false);
+    for (const auto &face : faces)
+    {
+        // nearest tracked face whose middle is within half a face of this one
+        const cv::Point2d faceCenter = center(face.box);
+        size_t best = _tracks.size();
+        double bestDistance = 0;
+        for (size_t i = 0; i < matched.size(); i++)
+        {
+            const double distance = cv::norm(center(_tracks[i].box) - faceCenter);
+            if (!matched[i] && distance < std::max(_tracks[i].box.width, static_cast<double>(face.box.width)) / 2
+                && (best == _tracks.size() || distance < bestDistance))
+            {
+                best = i;
+                bestDistance = distance;
+            }
+        }
+        if (best == _tracks.size())
+        {
+            _tracks.push_back(Track{face.box, face.confidence, 1, 0});
+            matched.push_back(true);
+            continue;
+        }
+        Track &track = _tracks[best];
+        const cv::Rect2d box = face.box;
+        track.box = cv::Rect2d(track.box.x + (box.x - track.box.x) * trackGain,
+                               track.box.y + (box.y - track.box.y) * trackGain,
+                               track.box.width + (box.width - track.box.width) * trackGain,
+                               track.box.height + (box.height - track.box.height) * trackGain);
+        track.confidence += (face.confidence - track.confidence) * trackGain;
+        track.hits++;
+        track.misses = 0;
+        matched[best] = true;
+    }
+    for (size_t i = 0; i < _tracks.size(); i++)
+    {
+        if (!matched[i])
+        {
+            _tracks[i].misses++;
+        }
+    }
+    _tracks.erase(std::remove_if(_tracks.begin(), _tracks.end(),
+                                 [](const Track &track) { return track.misses > maxMisses; }),
+                  _tracks.end());
+    retarget();
+}
+
+void FaceFraming::retarget() {
+    cv::Rect2d group;
+    bool found = false;
+    for (const auto &track : _tracks)
+    {
+        if (track.hits >= confirmHits)
+        {
+            group = found ? (group | track.box) : track.box;
+            found = true;
+        }
+    }
+    if (!found)
+    {
+        // nobody there (anymore), the window stays where it is
+        return;
+    }
+
+    const double maxSize = std::min(_imageSize.width, _imageSize.height);
+    const double needed = std::clamp(groupMargin * std::max(group.width, group.height),
+                                     static_cast<double>(_minWindowSize), maxSize);
+    if (!_seeded)
+    {
+        // jump to the first faces instead of gliding in from the middle
+        _seeded = true;
+        _targetCenter = _center = center(group);
+        _targetSize = _size = needed;
+        return;
+    }
+
+    // zoom out right away so nobody is cut off, zoom in only when it lasts
+    if (needed > _targetSize)
+    {
+        _targetSize = needed;
+        _shrinkCount = 0;
+    }
+    else if (needed < shrinkThreshold * _targetSize)
+    {
+        if (++_shrinkCount >= shrinkRuns)
+        {
+            _targetSize = needed;
+            _shrinkCount = 0;
+        }
+    }
+    else
+    {
+        _shrinkCount = 0;
+    }
+
+    const double margin = edgeMargin * _targetSize;
+    if (group.x < _targetCenter.x - _targetSize / 2 + margin
+        || group.y < _targetCenter.y - _targetSize / 2 + margin
+        || group.x + group.width > _targetCenter.x + _targetSize / 2 - margin
+        || group.y + group.height > _targetCenter.y + _targetSize / 2 - margin)
+    {
+        _targetCenter = center(group);
+    }
+}
+
+cv::Rect FaceFraming::step() {
+    _center += (_targetCenter - _center) * glideGain;
+    _size += (_targetSize - _size) * glideGain;
+    return window();
+}
+
+cv::Rect FaceFraming::window() const {
+    return clamp(_center, _size);
+}
+
+cv::Rect FaceFraming::clamp(const cv::Point2d &windowCenter, double size) const {
+    // shifted into the image rather than cut off, so the window stays square
+    const int side = std::min(static_cast<int>(std::lround(size)), std::min(_imageSize.width, _imageSize.height));
+    const int x = std::clamp(static_cast<int>(std::lround(windowCenter.x - side / 2.0)), 0, _imageSize.width - side);
+    const int y = std::clamp(static_cast<int>(std::lround(windowCenter.y - side / 2.0)), 0, _imageSize.height - side);
+    return {x, y, side, side};
+}
+
+size_t FaceFraming::faceCount() const {
+    return static_cast<size_t>(std::count_if(_tracks.begin(), _tracks.end(),
+                                              [](const Track &track) { return track.hits >= confirmHits; }));
+}
+
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <opencv2/core.hpp>
+#include <vector>
+#include "FaceDetector.hpp"
+
+namespace webcam {
+
+/// \brief Places the square window that is published around everybody in the picture.
+///
+/// Faces from every detection run update a set of tracked faces: a detection
+/// close to a tracked face moves it part of the way, others start a new one and
+/// faces missing for a few runs are dropped. Only faces seen twice count, so a
+/// single false detection doesn't move the window.
+/// The target window covers the bounding box of the counted faces with some room
+/// around it. It only moves once the group gets close to its edge and only zooms
+/// in after the group stayed smaller for a while, so it doesn't follow every
+/// small movement. The published window glides towards the target every frame.
+/// All of this works on rectangles only, the image is only touched when the
+/// window is cut out.
+class FaceFraming {
+public:
+    /// \param imageSize size of the image the faces are found in and the window is cut from
+    /// \param minWindowSize side of the window around a single face, also the side before the first face
+    FaceFraming(cv::Size imageSize, int minWindowSize);
+
+    /// \brief Takes the faces of one detection run.
+    void update(const std::vector<Face> &faces);
+
+    /// \brief Moves the window a step towards the target, call once per frame.
+    /// \return the window, inside the image
+    cv::Rect step();
+
+    /// \brief Window returned by the last step().
+    cv::Rect window() const;
+
+    int minWindowSize() const {
+        return _minWindowSize;
+    }
+
+    /// \brief Faces the window currently covers.
+    size_t faceCount() const;
+
+private:
+    struct Track {
+        cv::Rect2d box;
+        double confidence;
+        int hits;
+        int misses;
+    };
+
+    // room around the group, relative to its larger side
+    static constexpr double groupMargin{1.6};
+    // part of the window at each edge the group may enter before the window moves
+    static constexpr double edgeMargin{0.1};
+    // the window zooms in once the group needs less than this part of it ...
+    static constexpr double shrinkThreshold{0.75};
+    // ... for this many detection runs in a row
+    static constexpr int shrinkRuns{10};
+    static constexpr int confirmHits{2};
+    static constexpr int maxMisses{5};
+    // share of a new detection in a tracked face
+    static constexpr double trackGain{0.5};
+    // share of the target in the window per frame
+    static constexpr double glideGain{1 / 60.0};
+
+    const cv::Size _imageSize;
+    const int _minWindowSize;
+    std::vector<Track> _tracks;
+
+    // centre and side of the target and the published window
+    cv::Point2d _targetCenter;
+    double _targetSize;
+    cv::Point2d _center;
+    double _size;
+    bool _seeded{false};
+    int _shrinkCount{0};
+
+    void retarget();
+    cv::Rect clamp(const cv::Point2d &center, double size) const;
+};
+
+}
@@ -2,14 +2,16 @@
 #include <string>
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/types.h>
 #include <stdexcept>
 
 namespace webcam {
 
 class FileHandleWrapper {
 public:
-    FileHandleWrapper(const std::string &path, int flags) {
-        handle = open(path.c_str(), flags);
+    // mode is only used with O_CREAT
+    FileHandleWrapper(const std::string &path, int flags, mode_t mode = 0) {
+        handle = open(path.c_str(), flags, mode);
         if (handle <= -1)
         {
             throw std::runtime_error("Unable to open filehandle");
@@ -0,0 +1,497 @@
+#include "FramePipeline.hpp"
+#include "ColorTransform.hpp"
+#include "Metrics.hpp"
+#include "PixelKernels.hpp"
+#include "Trace.hpp"
+#include <stdexcept>
+#include <chrono>
+#include <algorithm>
+#include <libyuv.h>
+
+namespace webcam {
+
+namespace {
+
+double elapsed_ms(std::chrono::steady_clock::time_point &since) {
+    const auto now = std::chrono::steady_clock::now();
+    const double ms = std::chrono::duration<double, std::milli>(now - since).count();
+    since = now;
+    return ms;
+}
+
+// The stages that depend on the camera's pixel layout, one struct per SensorFormat.
+// When rawType equals workType the camera frame is undistorted as it is, without conversion.
+
+struct Mono8Stages {
+    static constexpr SensorFormat sensorFormat = SensorFormat::Mono8;
+    static constexpr int rawType = CV_8UC1;
+    // a quarter of the data BGRA would be, all the way to packing
+    static constexpr int workType = CV_8UC1;
+
+    // no color to transform, the transform is ignored
+    static void packYUY2Rows(const cv::Mat &gray, cv::Mat &yuy2, int rowBegin, int rowEnd, const ColorTransform *) {
+        const auto packRow = pixelKernels().packGrayYUY2;
+        for (int row = rowBegin; row < rowEnd; row++)
+        {
+            packRow(gray.ptr(row), yuy2.ptr(row), gray.cols);
+        }
+    }
+
+    static void packI422Rows(const cv::Mat &gray, cv::Mat &i422, int rowBegin, int rowEnd, const ColorTransform *) {
+        // the chroma rows stay at the neutral value they got when the buffer was created
+        libyuv::CopyPlane(gray.ptr(rowBegin), static_cast<int>(gray.step), i422.ptr(rowBegin),
+                          static_cast<int>(i422.step), gray.cols, rowEnd - rowBegin);
+    }
+};
+
+struct BGRAPacking {
+    static constexpr int workType = CV_8UC4;
+
+    // rows that go through the color transform at a time, small enough to still be in L1 when packed
+    static constexpr int gradedRows = 2;
+
+    // Calls pack(source, step, rowBegin, rowEnd) for the band, with the color transformed first
+    // if there is a transform. That's done gradedRows at a time into a buffer that is packed right
+    // away, so the transform costs no extra pass over the frame.
+    template<typename Pack>
+    static void forGradedRows(const cv::Mat &bgra, int rowBegin, int rowEnd, const ColorTransform *color,
+                              Pack pack) {
+        if (color == nullptr)
+        {
+            pack(bgra.ptr(rowBegin), static_cast<int>(bgra.step), rowBegin, rowEnd);
+            return;
+        }
+        thread_local std::vector<uint8_t> graded;
+        graded.resize(4 * static_cast<size_t>(bgra.cols) * gradedRows);
+        const auto lutRow = pixelKernels().lutBGRA;
+        const ColorLut lut = color->lut();
+        for (int begin = rowBegin; begin < rowEnd; begin += gradedRows)
+        {
+            const int end = std::min(begin + gradedRows, rowEnd);
+            for (int row = begin; row < end; row++)
+            {
+                lutRow(bgra.ptr(row), &graded[4 * static_cast<size_t>(bgra.cols) * (row - begin)], bgra.cols, lut);
+            }
+            pack(graded.data(), 4 * bgra.cols, begin, end);
+        }
+    }
+
+    static void packYUY2Rows(const cv::Mat &bgra, cv::Mat &yuy2, int rowBegin, int rowEnd,
+                             const ColorTransform *color) {
+        forGradedRows(bgra, rowBegin, rowEnd, color, [&](const uint8_t *src, int step, int begin, int end) {
+            // even though the method is called ARGB 2 yuv2 it requires the source image to be in BGRA format
+            // or else everything has a blue tinge
+            libyuv::ARGBToYUY2(src, step, yuy2.ptr(begin), static_cast<int>(yuy2.step), bgra.cols, end - begin);
+        });
+    }
+
+    static void packI422Rows(const cv::Mat &bgra, cv::Mat &i422, int rowBegin, int rowEnd,
+                             const ColorTransform *color) {
+        forGradedRows(bgra, rowBegin, rowEnd, color, [&](const uint8_t *src, int step, int begin, int end) {
+            uint8_t *chroma = i422.ptr(bgra.rows + begin);
+            libyuv::ARGBToI422(src, step,
+                               i422.ptr(begin), static_cast<int>(i422.step),
+                               chroma, static_cast<int>(i422.step),
+                               chroma + i422.cols / 2, static_cast<int>(i422.step),
+                               bgra.cols, end - begin);
+        });
+    }
+};
+
+struct BGR888Stages : BGRAPacking {
+    static constexpr SensorFormat sensorFormat = SensorFormat::BGR888;
+    static constexpr int rawType = CV_8UC3;
+
+    static void convertRows(const cv::Mat &raw, cv::Mat &bgra, int rowBegin, int rowEnd) {
+        cv::Mat dst = bgra.rowRange(rowBegin, rowEnd);
+        cv::cvtColor(raw.rowRange(rowBegin, rowEnd), dst, cv::COLOR_RGB2BGRA);
+    }
+};
+
+struct YUV422Stages : BGRAPacking {
+    static constexpr SensorFormat sensorFormat = SensorFormat::YUV422;
+    static constexpr int rawType = CV_8UC2;
+
+    static void convertRows(const cv::Mat &raw, cv::Mat &bgra, int rowBegin, int rowEnd) {
+        // ARGB is BGRA in memory for libyuv, see packYUY2Rows
+        libyuv::YUY2ToARGB(raw.ptr(rowBegin), static_cast<int>(raw.step),
+                           bgra.ptr(rowBegin), static_cast<int>(bgra.step),
+                           raw.cols, rowEnd - rowBegin);
+    }
+};
+
+template<typename Stages>
+class PipelineVariant final : public FramePipeline {
+public:
+    PipelineVariant(const std::vector<OutputConfig> &outputs, ThreadPool &threadPool, int bandRows)
+        : FramePipeline(outputs, threadPool, bandRows, Stages::workType) {
+    }
+
+    SensorFormat sensorFormat() const override {
+        return Stages::sensorFormat;
+    }
+
+protected:
+    const cv::Mat &convert(const RawFrame &frame) override {
+        _raw = cv::Mat(frame.height, frame.width, Stages::rawType, frame.data);
+        if constexpr (Stages::rawType == Stages::workType)
+        {
+            return _raw;
+        }
+        else
+        {
+            _converted.create(frame.height, frame.width, Stages::workType);
+            _threadPool.parallelFor(0, frame.height, _bandRows, [&](int begin, int end) {
+                Stages::convertRows(_raw, _converted, begin, end);
+            }, "convert");
+            return _converted;
+        }
+    }
+
+    void pack(Branch &branch, bool statistics, const ColorTransform *color) override {
+        const cv::Mat &scaled = branch.scaled;
+        // Mono8 ignores the transform
+        const bool graded = color != nullptr && Stages::workType == CV_8UC4;
+        if (branch.format == PixelFormat::MJPEG)
+        {
+            if (branch.packed.empty())
+            {
+                // the padding columns are never written, keep them defined
+                branch.packed = cv::Mat::zeros(2 * scaled.rows, (scaled.cols + 15) & ~15, CV_8UC1);
+                branch.packed.rowRange(scaled.rows, 2 * scaled.rows).setTo(128);
+            }
+            _threadPool.parallelFor(0, scaled.rows, _bandRows, [&](int begin, int end) {
+                Stages::packI422Rows(scaled, branch.packed, begin, end, color);
+                if (statistics)
+                {
+                    accumulateStatistics(branch, begin, end, graded);
+                }
+            }, "pack I422");
+            return;
+        }
+
+        branch.packed.create(scaled.size(), CV_8UC2);
+        _threadPool.parallelFor(0, scaled.rows, _bandRows, [&](int begin, int end) {
+            Stages::packYUY2Rows(scaled, branch.packed, begin, end, color);
+            if (statistics)
+            {
+                // the band was just written and is still in cache
+                accumulateStatistics(branch, begin, end, graded);
+            }
+        }, "pack YUY2");
+    }
+
+private:
+    // wraps the camera's buffer
+    cv::Mat _raw;
+    cv::Mat _converted;
+};
+
+}
+
+std::unique_ptr<FramePipeline> FramePipeline::create(SensorFormat format, const std::vector<OutputConfig> &outputs,
+                                                     ThreadPool &threadPool, int bandRows) {
+    switch (format)
+    {
+        case SensorFormat::Mono8:
+            return std::make_unique<PipelineVariant<Mono8Stages>>(outputs, threadPool, bandRows);
+        case SensorFormat::YUV422:
+            return std::make_unique<PipelineVariant<YUV422Stages>>(outputs, threadPool, bandRows);
+        case SensorFormat::BGR888:
+            return std::make_unique<PipelineVariant<BGR888Stages>>(outputs, threadPool, bandRows);
+    }
+    throw std::invalid_argument("unknown sensor format");
+}
+
+FramePipeline::FramePipeline(const std::vector<OutputConfig> &outputs, ThreadPool &threadPool, int bandRows,
+                             int workType)
+    : _threadPool(threadPool), _bandRows(bandRows), _workType(workType),
+      _denoiser(_undistortedRegion.size(), 0, workType),
+      _detectionsRun(Metrics::global().counter(metricsName(outputs) + ".detection.run")),
+      _detectionsSkipped(Metrics::global().counter(metricsName(outputs) + ".detection.skipped")),
+      _detectionTimeSaved_ms(Metrics::global().gauge(metricsName(outputs) + ".detection.saved_ms")),
+      _framedFaces(Metrics::global().gauge(metricsName(outputs) + ".framing.faces")) {
+    if (outputs.empty())
+    {
+        throw std::runtime_error("No output");
+    }
+    for (const auto &output : outputs)
+    {
+        if (output.height == 0 || output.width == 0)
+        {
+            throw std::runtime_error("Illegal frame heigh/width");
+        }
+        _branches.push_back(Branch{output.width, output.height, output.format, cv::Mat(), cv::Mat()});
+    }
+    if (bandRows <= 0)
+    {
+        throw std::runtime_error("Illegal band size");
+    }
+}
+
+std::string FramePipeline::metricsName(const std::vector<OutputConfig> &outputs) {
+    // named after the main output like the sink's metrics
+    return outputs.empty() ? std::string() : outputs.front().device;
+}
+
+const cv::Mat &FramePipeline::process(const RawFrame &frame, const std::vector<bool> &wanted) {
+    TRACE_SCOPE("process");
+    if (frame.width <= 0 || frame.height <= 0 || frame.binningX <= 0 || frame.binningY <= 0
+        || frame.offsetX + frame.width * frame.binningX > Undistortion::cameraWidth
+        || frame.offsetY + frame.height * frame.binningY > Undistortion::cameraHeight
+        || frame.channelCount != bytesPerPixel(sensorFormat()) || frame.data == nullptr)
+    {
+        throw std::invalid_argument("illegal input");
+    }
+    frameCounter++;
+    _stageTimes = StageTimes();
+    auto stageStart = std::chrono::steady_clock::now();
+
+    const cv::Mat &converted = convert(frame);
+    _stageTimes.convert_ms = elapsed_ms(stageStart);
+
+    // undistort, only the part that is used later on
+    _undistortion.setLayout(_undistortedRegion, cv::Point(frame.offsetX, frame.offsetY), frame.binningX,
+                            frame.binningY);
+    const bool denoise = _denoiser.strength() > 0;
+    // looking for faces needs the whole region, and the noise filter keeps it from frame to frame;
+    // on all other frames only the window is undistorted
+    const bool detectionFrame = (frameCounter % _detectionInterval) == 0 && _faceDetector.ready();
+    cv::Mat faceROI;
+    if (denoise || detectionFrame)
+    {
+        _undistorted.create(_undistortedRegion.size(), _workType);
+        cv::Mat &image = denoise ? _denoiser.beginFrame() : _undistorted;
+        _threadPool.parallelFor(0, _undistorted.rows, _bandRows, [&](int begin, int end) {
+            _undistortion.undistortImage(converted, _undistorted, begin, end);
+            if (denoise)
+            {
+                // before sharpening, which would amplify the noise; the band is still in cache
+                _denoiser.filterRows(_undistorted, begin, end);
+            }
+        }, "undistort");
+        _stageTimes.undistort_ms = elapsed_ms(stageStart);
+
+        // detect faces
+        if (detectionFrame && detectionNeeded(image))
+        {
+            // save cpu by only detecting so often and only if something moved,
+            // but move the window every frame to have smooth movement;
+            // until the detector is loaded the frames go out with the last window
+            TRACE_SCOPE("detect face");
+            auto detectionStart = std::chrono::steady_clock::now();
+            const auto faces = _faceDetector.detectFaces(image);
+            const double detection_ms = elapsed_ms(detectionStart);
+            _stageTimes.detect_ms = detection_ms;
+            _detectionCost_ms = _detectionsRun == 0 ? detection_ms : 0.9 * _detectionCost_ms + 0.1 * detection_ms;
+            _detectionsRun++;
+            _framing.update(faces);
+            _framedFaces = static_cast<double>(_framing.faceCount());
+        }
+        faceROI = cv::Mat(image, _framing.step());
+    }
+    else
+    {
+        faceROI = undistortWindow(converted, _framing.step());
+        _stageTimes.undistort_ms = elapsed_ms(stageStart);
+    }
+    // the change detection and framing count towards neither stage
+    stageStart = std::chrono::steady_clock::now();
+
+    if (_pyramid.empty())
+    {
+        _pyramid.resize(1);
+    }
+    if (_sharpening)
+    {
+        sharpen(faceROI, _pyramid[0]);
+    }
+    else
+    {
+        faceROI.copyTo(_pyramid[0]);
+    }
+    _pyramidLevels = 1;
+    _stageTimes.sharpen_ms = elapsed_ms(stageStart);
+
+    // Resize to fit every video target, all with the same transform even if another one is set meanwhile
+    const std::shared_ptr<const ColorTransform> color = std::atomic_load(&_colorTransform);
+    _statistics = FaceStatistics();
+    for (size_t i = 0; i < _branches.size(); i++)
+    {
+        if (wanted.empty() || (i < wanted.size() && wanted[i]))
+        {
+            Branch &branch = _branches[i];
+            branch.scaled.create(static_cast<int>(branch.height), static_cast<int>(branch.width), _workType);
+            resize(pyramidSource(branch.width, branch.height), branch.scaled);
+            _stageTimes.scale_ms += elapsed_ms(stageStart);
+            pack(branch, i == 0 && _statisticsEnabled, color.get());
+            _stageTimes.pack_ms += elapsed_ms(stageStart);
+        }
+    }
+
+    return _branches.front().packed;
+}
+
+const cv::Mat &FramePipeline::pyramidSource(unsigned int width, unsigned int height) {
+    // smallest level that is still at least the output size, the linear resize
+    // from there samples every source pixel instead of skipping some
+    size_t level = 0;
+    while (true)
+    {
+        const cv::Mat &current = _pyramid[level];
+        if (static_cast<unsigned int>(current.cols / 2) < width || static_cast<unsigned int>(current.rows / 2) < height)
+        {
+            return current;
+        }
+        level++;
+        if (level >= _pyramidLevels)
+        {
+            // the window is small, one thread does this faster than handing out bands
+            if (_pyramid.size() <= level)
+            {
+                _pyramid.emplace_back();
+            }
+            TRACE_SCOPE("pyrDown", static_cast<int64_t>(level));
+            cv::pyrDown(_pyramid[level - 1], _pyramid[level]);
+            _pyramidLevels = level + 1;
+        }
+    }
+}
+
+bool FramePipeline::detectionNeeded(const cv::Mat &image) {
+    TRACE_SCOPE("detect change");
+    _changeDetector.update(image);
+    if (frameCounter - _lastDetectionFrame < forcedDetectionFrames && !_changeDetector.changed(_framing.window()))
+    {
+        _detectionsSkipped++;
+        _detectionTimeSaved_ms = _detectionTimeSaved_ms + _detectionCost_ms;
+        return false;
+    }
+    _lastDetectionFrame = frameCounter;
+    _changeDetector.markReference();
+    return true;
+}
+
+cv::Rect FramePipeline::requiredSensorRegion() const {
+    return _undistortion.sourceRegion(_undistortedRegion);
+}
+
+bool FramePipeline::binningIsLossless() const {
+    return std::all_of(_branches.begin(), _branches.end(), [this](const Branch &branch) {
+        return 2 * branch.width <= static_cast<unsigned int>(_framing.minWindowSize())
+               && 2 * branch.height <= static_cast<unsigned int>(_framing.minWindowSize());
+    });
+}
+
+void FramePipeline::accumulateStatistics(const Branch &branch, int rowBegin, int rowEnd, bool graded) {
+    const auto start = std::chrono::steady_clock::now();
+    const cv::Mat &output = branch.packed;
+    const int width = static_cast<int>(branch.width) & ~1;
+    FaceStatistics band;
+    const auto addYUYV = [&band, width](const uint8_t *yuyv) {
+        for (int x = 0; x < width; x += 2, yuyv += 4)
+        {
+            band.lumaHistogram[yuyv[0]]++;
+            band.lumaHistogram[yuyv[2]]++;
+            band.sumU += yuyv[1];
+            band.sumV += yuyv[3];
+        }
+    };
+    // the sampled rows packed once more without the transform
+    thread_local std::vector<uint8_t> ungraded;
+    if (graded)
+    {
+        ungraded.resize(2 * static_cast<size_t>(width));
+    }
+    // start on an even row so the sampled rows don't depend on the band size
+    for (int row = rowBegin + (rowBegin & 1); row < rowEnd; row += 2)
+    {
+        if (graded)
+        {
+            libyuv::ARGBToYUY2(branch.scaled.ptr(row), static_cast<int>(branch.scaled.step), ungraded.data(),
+                               2 * width, width, 1);
+            addYUYV(ungraded.data());
+        }
+        else if (branch.format == PixelFormat::MJPEG)
+        {
+            const uint8_t *y = output.ptr(row);
+            const uint8_t *u = output.ptr(static_cast<int>(branch.height) + row);
+            const uint8_t *v = u + output.cols / 2;
+            for (int x = 0; x < width; x += 2)
+            {
+                band.lumaHistogram[y[x]]++;
+                band.lumaHistogram[y[x + 1]]++;
+                band.sumU += u[x / 2];
+                band.sumV += v[x / 2];
+            }
+        }
+        else
+        {
+            addYUYV(output.ptr(row));
+        }
+        band.samples += width;
+    }
+    const double cost_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    std::lock_guard<std::mutex> lock(_statisticsMutex);
+    for (size_t i = 0; i < band.lumaHistogram.size(); i++)
+    {
+        _statistics.lumaHistogram[i] += band.lumaHistogram[i];
+    }
+    _statistics.sumU += band.sumU;
+    _statistics.sumV += band.sumV;
+    _statistics.samples += band.samples;
+    _statistics.cost_us += cost_us;
+}
+
+cv::Mat FramePipeline::undistortWindow(const cv::Mat &converted, const cv::Rect &window) {
+    // with the pixels around it that sharpening reads, so the window comes out as if it was
+    // cut from the whole undistorted region
+    const cv::Rect margined = cv::Rect(window.x - sharpenMargin, window.y - sharpenMargin,
+                                       window.width + 2 * sharpenMargin, window.height + 2 * sharpenMargin)
+                              & cv::Rect(cv::Point(), _undistortedRegion.size());
+    _undistortion.setWindow(margined, margined.size());
+    _undistortedWindow.create(margined.size(), _workType);
+    _threadPool.parallelFor(0, _undistortedWindow.rows, _bandRows, [&](int begin, int end) {
+        _undistortion.undistortWindow(converted, _undistortedWindow, begin, end);
+    }, "undistort window");
+    return _undistortedWindow(cv::Rect(window.x - margined.x, window.y - margined.y, window.width, window.height));
+}
+
+void FramePipeline::sharpen(const cv::Mat &img, cv::Mat &sharpened) {
+    sharpened.create(img.size(), img.type());
+    _threadPool.parallelFor(0, img.rows, _bandRows, [&](int begin, int end) {
+        // img is a view into the full frame, the blur reads the rows around the band from
+        // there so the bands come out exactly as if the whole image was blurred at once
+        cv::Mat imgBand = img.rowRange(begin, end);
+        cv::Mat sharpenedBand = sharpened.rowRange(begin, end);
+
+        cv::Mat blurred;
+        double sigma = 1;
+        int threshold = 2, amount = 1;
+        cv::GaussianBlur(imgBand, blurred, cv::Size(), sigma, sigma);
+        // the unsharp mask itself in one pass instead of OpenCV's difference, mask, addWeighted and copy
+        const auto sharpenRow = pixelKernels().sharpen;
+        const int bytes = img.cols * img.channels();
+        for (int row = 0; row < imgBand.rows; row++)
+        {
+            sharpenRow(imgBand.ptr(row), blurred.ptr(row), sharpenedBand.ptr(row), bytes, threshold, amount);
+        }
+    }, "sharpen");
+}
+
+void FramePipeline::resize(const cv::Mat &src, cv::Mat &dst) {
+    // same sampling as cv::resize with INTER_LINEAR, but expressed as an affine map
+    // so every band of output rows can be produced independently
+    const double scaleX = static_cast<double>(src.cols) / dst.cols;
+    const double scaleY = static_cast<double>(src.rows) / dst.rows;
+    _threadPool.parallelFor(0, dst.rows, _bandRows, [&](int begin, int end) {
+        cv::Mat dstBand = dst.rowRange(begin, end);
+        cv::Matx23d dstToSrc(scaleX, 0, 0.5 * scaleX - 0.5,
+                             0, scaleY, (begin + 0.5) * scaleY - 0.5);
+        cv::warpAffine(src, dstBand, dstToSrc, dstBand.size(), cv::INTER_LINEAR | cv::WARP_INVERSE_MAP,
+                       cv::BORDER_REPLICATE);
+    }, "resize");
+}
+
+}
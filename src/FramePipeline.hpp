@@ -0,0 +1,235 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <mutex>
+#include <vector>
+#include "Undistortion.hpp"
+#include "FaceDetector.hpp"
+#include "FaceFraming.hpp"
+#include "ThreadPool.hpp"
+#include "RawFrame.hpp"
+#include "TemporalDenoiser.hpp"
+#include "ChangeDetector.hpp"
+#include "OutputConfig.hpp"
+
+namespace webcam {
+
+class ColorTransform;
+
+/// \brief Luma/chroma statistics of the published face window, gathered while packing it.
+/// Taken before the color transform, so exposure and white balance don't chase the grading.
+struct FaceStatistics {
+    std::array<unsigned int, 256> lumaHistogram{};
+    unsigned long sumU{0};
+    unsigned long sumV{0};
+    // luma samples, there are half as many U and V samples
+    unsigned long samples{0};
+    double cost_us{0};
+};
+
+/// \brief Wall time of each stage in one FramePipeline::process() call, 0 for stages that didn't run.
+struct StageTimes {
+    double convert_ms{0};
+    // the whole used region or just the window, including the noise filter
+    double undistort_ms{0};
+    double detect_ms{0};
+    // or copying the window while sharpening is off
+    double sharpen_ms{0};
+    // pyrDown and resize of all wanted outputs
+    double scale_ms{0};
+    // including the statistics
+    double pack_ms{0};
+};
+
+/// \brief Turns raw camera frames into the YUY2 frames that are published.
+///
+/// Color conversion, undistortion, sharpening, scaling and packing are split
+/// into row bands of bandRows rows and run on the given thread pool. Only frames
+/// that are searched for faces or denoised are undistorted in full, the others
+/// just in the window that is published (see Undistortion::setWindow).
+/// For PixelFormat::MJPEG the last step packs planar 4:2:2 for JpegEncoder instead of YUY2.
+/// An optional ColorTransform is applied to color frames while packing them.
+/// Optionally a temporal noise filter runs right after undistortion.
+///
+/// There can be several outputs (simulcast). Everything up to the sharpened
+/// face window is done once per frame, each output only adds its own scaling
+/// and packing. Outputs at most half the window size scale from a pyrDown
+/// level of it that is shared between them.
+///
+/// The stages that touch the camera's pixel layout are compiled once per
+/// SensorFormat, create() picks the variant. Mono frames stay single channel
+/// up to packing, color frames are processed as BGRA.
+class FramePipeline {
+public:
+    static std::unique_ptr<FramePipeline> create(SensorFormat format, const std::vector<OutputConfig> &outputs,
+                                                 ThreadPool &threadPool, int bandRows);
+
+    virtual ~FramePipeline() = default;
+
+    FramePipeline(const FramePipeline &) = delete;
+    FramePipeline(FramePipeline &&) = delete;
+    FramePipeline &operator=(const FramePipeline &) = delete;
+    FramePipeline &operator=(FramePipeline &&) = delete;
+
+    /// \brief Format process() expects, frames with a different RawFrame::channelCount are rejected.
+    virtual SensorFormat sensorFormat() const = 0;
+
+    /// \brief Processes one camera frame for the outputs set in wanted (all if empty).
+    /// \return output(0)
+    const cv::Mat &process(const RawFrame &frame, const std::vector<bool> &wanted = {});
+
+    /// \brief Packed frame of an output, valid until the next process() call that includes the output.
+    /// YUY2 of the output's width x height. For MJPEG a single channel image of 2 * height rows: the
+    /// Y plane, then one row per image row holding U and, from cols / 2 on, V. cols is the width
+    /// padded to 16 as libjpeg reads whole MCUs.
+    const cv::Mat &output(size_t index) const {
+        return _branches.at(index).packed;
+    }
+
+    size_t outputCount() const {
+        return _branches.size();
+    }
+
+    /// \brief Part of the sensor (full resolution pixels) the pipeline actually uses, a sensor AOI
+    /// covering it gives the same output.
+    cv::Rect requiredSensorRegion() const;
+
+    /// \brief True if 2x2 binned frames give the same output, i.e. the face window is downscaled
+    /// at least by two anyway, even at its smallest.
+    bool binningIsLossless() const;
+
+    /// \brief Enables FaceStatistics, collected from every second row of the packed output 0.
+    void setStatisticsEnabled(bool enabled) {
+        _statisticsEnabled = enabled;
+    }
+
+    /// \brief Strength of the temporal noise filter after undistortion, see TemporalDenoiser, 0 is off.
+    /// Not while process() runs.
+    void setDenoiseStrength(int strength) {
+        _denoiser.setStrength(strength);
+    }
+
+    /// \brief Lens shading correction applied while undistorting, see Undistortion::setShading.
+    /// Not while process() runs.
+    void setShading(const cv::Mat &sensorGain) {
+        _undistortion.setShading(sensorGain);
+    }
+
+    /// \brief Color correction of the packed outputs, null is none. Ignored for Mono8.
+    /// May be called while process() runs, every output of the frames processed from then on uses the new one.
+    void setColorTransform(std::shared_ptr<const ColorTransform> transform) {
+        std::atomic_store(&_colorTransform, std::move(transform));
+    }
+
+    /// \brief Unsharp masking of the face window, on by default. Not while process() runs.
+    void setSharpening(bool enabled) {
+        _sharpening = enabled;
+    }
+
+    // frames between two face searches by default
+    static constexpr int detectionWaitFrames{3};
+
+    /// \brief Faces are searched on every frames-th frame. Not while process() runs.
+    void setDetectionInterval(int frames) {
+        _detectionInterval = std::max(frames, 1);
+    }
+
+    /// \brief False while the face detector is still loading, the window doesn't follow the face until then.
+    bool faceDetectionReady() {
+        return _faceDetector.ready();
+    }
+
+    /// \brief Statistics of the last processed frame, empty if output 0 wasn't wanted.
+    const FaceStatistics &statistics() const {
+        return _statistics;
+    }
+
+    /// \brief Where the time of the last process() call went.
+    const StageTimes &stageTimes() const {
+        return _stageTimes;
+    }
+
+protected:
+    /// \param workType type of the images between conversion and packing
+    FramePipeline(const std::vector<OutputConfig> &outputs, ThreadPool &threadPool, int bandRows, int workType);
+
+    struct Branch {
+        unsigned int width;
+        unsigned int height;
+        PixelFormat format;
+        // scaled to the output size, still of the work type
+        cv::Mat scaled;
+        // YUY2 or planar 4:2:2, see output()
+        cv::Mat packed;
+    };
+
+    /// \brief Camera frame to the work type, returns the image undistortion reads.
+    virtual const cv::Mat &convert(const RawFrame &frame) = 0;
+    /// \brief Branch::scaled to Branch::packed, accumulating statistics on the way if asked to.
+    /// \param color transform of the frame, the same for every branch, null is none
+    virtual void pack(Branch &branch, bool statistics, const ColorTransform *color) = 0;
+
+    ThreadPool &_threadPool;
+    int _bandRows;
+    bool _statisticsEnabled{false};
+    // only accessed with std::atomic_load/atomic_store, see setColorTransform()
+    std::shared_ptr<const ColorTransform> _colorTransform;
+    // graded: Branch::packed went through the color transform, the statistics come from Branch::scaled then
+    void accumulateStatistics(const Branch &branch, int rowBegin, int rowEnd, bool graded);
+
+private:
+    int _workType;
+    std::vector<Branch> _branches;
+    Undistortion _undistortion;
+    FaceDetector _faceDetector;
+
+    // undistortion creates black areas in the top and bottom, only this part of the undistorted image is used
+    const cv::Rect _undistortedRegion{0, 40, Undistortion::cameraWidth, 400};
+    TemporalDenoiser _denoiser;
+
+    // kept between frames so the buffers are only allocated once
+    cv::Mat _undistorted;
+    // just the window and sharpenMargin pixels around it, on frames that don't need the whole region
+    cv::Mat _undistortedWindow;
+    // level 0 is the sharpened face window, the others are built on demand each frame
+    std::vector<cv::Mat> _pyramid;
+    size_t _pyramidLevels{0};
+
+    FaceStatistics _statistics;
+    std::mutex _statisticsMutex;
+    StageTimes _stageTimes;
+
+    // the window around the faces, at least 250 pixels
+    FaceFraming _framing{_undistortedRegion.size(), 250};
+
+    int _detectionInterval{detectionWaitFrames};
+    bool _sharpening{true};
+    int frameCounter{0};
+
+    // detection only runs when the scene changed, or after this many frames anyway
+    static constexpr int forcedDetectionFrames{30};
+    ChangeDetector _changeDetector;
+    int _lastDetectionFrame{0};
+    // average time of a detection
+    double _detectionCost_ms{0};
+    // <device of output 0>.detection.* in Metrics
+    std::atomic<unsigned long> &_detectionsRun;
+    std::atomic<unsigned long> &_detectionsSkipped;
+    std::atomic<double> &_detectionTimeSaved_ms;
+    std::atomic<double> &_framedFaces;
+    bool detectionNeeded(const cv::Mat &image);
+    static std::string metricsName(const std::vector<OutputConfig> &outputs);
+
+    // rows and columns the blur in sharpen() reads beyond a band
+    static constexpr int sharpenMargin{3};
+    cv::Mat undistortWindow(const cv::Mat &converted, const cv::Rect &window);
+    void sharpen(const cv::Mat &img, cv::Mat &sharpened);
+    const cv::Mat &pyramidSource(unsigned int width, unsigned int height);
+    void resize(const cv::Mat &src, cv::Mat &dst);
+};
+
+}
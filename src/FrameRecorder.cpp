@@ -0,0 +1,180 @@
+#include "FrameRecorder.hpp"
+#include "Metrics.hpp"
+#include "Trace.hpp"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+using namespace std::chrono;
+
+namespace webcam {
+
+namespace {
+
+size_t alignedSize(size_t size) {
+    return (size + RecordedFrameHeader::alignment - 1) & ~(RecordedFrameHeader::alignment - 1);
+}
+
+bool writeAll(int fd, const uint8_t *data, size_t size) {
+    while (size > 0)
+    {
+        const ssize_t written = ::write(fd, data, size);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+}
+
+FrameRecorder::FrameRecorder(const std::string &file, const std::string &serial)
+    : _file(file), _fd(file, O_WRONLY | O_CREAT | O_TRUNC, 0644),
+      _framesRecorded(Metrics::global().counter(serial + ".recorder.framesRecorded")),
+      _framesDropped(Metrics::global().counter(serial + ".recorder.framesDropped")),
+      _bytesWritten(Metrics::global().counter(serial + ".recorder.bytesWritten")) {
+    RecordingHeader header{};
+    std::memcpy(header.magic, RecordingHeader::magicValue, sizeof(header.magic));
+    header.version = RecordingHeader::currentVersion;
+    std::strncpy(header.serial, serial.c_str(), sizeof(header.serial) - 1);
+    if (!writeAll(_fd.get(), reinterpret_cast<const uint8_t *>(&header), sizeof(header)))
+    {
+        throw std::runtime_error("cannot write " + file);
+    }
+
+    // written once here, so the capture thread doesn't take the page faults
+    _current.resize(batchSize);
+    _current.clear();
+    _currentStarted = steady_clock::now();
+    for (int i = 1; i < batchCount; i++)
+    {
+        _free.emplace_back(batchSize);
+        _free.back().clear();
+    }
+    _writeThread = std::thread(&FrameRecorder::threadMain, this);
+}
+
+FrameRecorder::~FrameRecorder() {
+    handOver();
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _threadShouldRun = false;
+    }
+    _batchAvailable.notify_one();
+    _writeThread.join();
+}
+
+void FrameRecorder::record(const RawFrame &frame, const FrameInfo &info) {
+    const size_t dataSize = static_cast<size_t>(frame.width) * frame.height * frame.channelCount;
+    const size_t recordSize = sizeof(RecordedFrameHeader) + alignedSize(dataSize);
+    if (frame.data == nullptr || recordSize > batchSize)
+    {
+        throw std::invalid_argument("frame can't be recorded");
+    }
+
+    const auto now = steady_clock::now();
+    if (_current.capacity() < batchSize || _current.size() + recordSize > batchSize
+        || now - _currentStarted > maxBatchAge)
+    {
+        handOver();
+    }
+    if (_current.capacity() < batchSize)
+    {
+        // every buffer is waiting for the disk
+        _framesDropped++;
+        return;
+    }
+
+    RecordedFrameHeader header{};
+    header.magic = RecordedFrameHeader::magicValue;
+    header.dataSize = static_cast<uint32_t>(dataSize);
+    header.timestamp_us = info.timestamp_us;
+    header.expose_us = info.expose_us;
+    header.gain_dB = info.gain_dB;
+    header.width = frame.width;
+    header.height = frame.height;
+    header.channelCount = frame.channelCount;
+    header.offsetX = frame.offsetX;
+    header.offsetY = frame.offsetY;
+    header.binningX = frame.binningX;
+    header.binningY = frame.binningY;
+
+    // capacity is reserved, none of this reallocates
+    const size_t start = _current.size();
+    _current.resize(start + recordSize);
+    std::memcpy(_current.data() + start, &header, sizeof(header));
+    std::memcpy(_current.data() + start + sizeof(header), frame.data, dataSize);
+    std::memset(_current.data() + start + sizeof(header) + dataSize, 0, recordSize - sizeof(header) - dataSize);
+    _framesRecorded++;
+}
+
+void FrameRecorder::handOver() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_current.empty())
+        {
+            _full.push_back(std::move(_current));
+        }
+        if (_free.empty())
+        {
+            _current = std::vector<uint8_t>();
+        }
+        else
+        {
+            _current = std::move(_free.front());
+            _free.pop_front();
+        }
+    }
+    _currentStarted = steady_clock::now();
+    _batchAvailable.notify_one();
+}
+
+void FrameRecorder::threadMain() {
+    TRACE_THREAD_NAME(_file + " recorder");
+    bool failed = false;
+    while (true)
+    {
+        std::vector<uint8_t> batch;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _batchAvailable.wait(lock, [this] { return !_full.empty() || !_threadShouldRun; });
+            if (_full.empty())
+            {
+                // stopped and everything is written
+                return;
+            }
+            batch = std::move(_full.front());
+            _full.pop_front();
+        }
+
+        if (!failed)
+        {
+            TRACE_SCOPE("recorder write");
+            if (writeAll(_fd.get(), batch.data(), batch.size()))
+            {
+                _bytesWritten += batch.size();
+            }
+            else
+            {
+                // keep cycling the buffers so capture isn't affected, the recording is cut off here
+                failed = true;
+                std::cout << "Error writing " << _file << ": " << std::strerror(errno) << ", recording stopped"
+                          << std::endl;
+            }
+        }
+
+        batch.clear();
+        std::lock_guard<std::mutex> lock(_mutex);
+        _free.push_back(std::move(batch));
+    }
+}
+
+}
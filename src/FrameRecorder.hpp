@@ -0,0 +1,104 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "FileHandleWrapper.hpp"
+#include "RawFrame.hpp"
+
+namespace webcam {
+
+/// \brief Capture metadata that is recorded with every frame.
+struct FrameInfo {
+    // camera timestamp of the exposure
+    int64_t timestamp_us{0};
+    double expose_us{0};
+    double gain_dB{0};
+};
+
+// Recording file layout: a RecordingHeader, then for every frame a RecordedFrameHeader
+// followed by the pixel data, padded so the next header is aligned again.
+struct RecordingHeader {
+    static constexpr char magicValue[8] = {'M', 'V', 'B', 'F', 'R', 'E', 'C', '\0'};
+    static constexpr uint32_t currentVersion{1};
+
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    char serial[48];
+};
+
+struct RecordedFrameHeader {
+    static constexpr uint32_t magicValue{0x454d5246}; // "FRME"
+    static constexpr size_t alignment{64};
+
+    uint32_t magic;
+    uint32_t dataSize;
+    int64_t timestamp_us;
+    double expose_us;
+    double gain_dB;
+    int32_t width;
+    int32_t height;
+    int32_t channelCount;
+    int32_t offsetX;
+    int32_t offsetY;
+    int32_t binningX;
+    int32_t binningY;
+    int32_t reserved;
+};
+
+static_assert(sizeof(RecordingHeader) % RecordedFrameHeader::alignment == 0, "frame headers must stay aligned");
+static_assert(sizeof(RecordedFrameHeader) == RecordedFrameHeader::alignment, "unexpected frame header padding");
+
+/// \brief Appends raw camera frames to a file for FrameReplay.
+///
+/// record() only copies the frame into the current batch buffer. Full batches
+/// are written by a background thread with one write() each. When the disk
+/// falls behind and all batch buffers are queued, frames are dropped (and
+/// counted) instead of stalling the capture thread.
+class FrameRecorder {
+public:
+    FrameRecorder(const std::string &file, const std::string &serial);
+    ~FrameRecorder();
+
+    FrameRecorder(const FrameRecorder &) = delete;
+    FrameRecorder(FrameRecorder &&) = delete;
+    FrameRecorder &operator=(const FrameRecorder &) = delete;
+    FrameRecorder &operator=(FrameRecorder &&) = delete;
+
+    /// \brief Queues one frame, to be called from a single (capture) thread.
+    void record(const RawFrame &frame, const FrameInfo &info);
+
+private:
+    static constexpr size_t batchSize{8 << 20};
+    static constexpr int batchCount{4};
+    // a batch is handed over after this long even if not full, so a crash loses little
+    static constexpr std::chrono::seconds maxBatchAge{1};
+
+    const std::string _file;
+    FileHandleWrapper _fd;
+
+    // capture thread only
+    std::vector<uint8_t> _current;
+    std::chrono::steady_clock::time_point _currentStarted;
+    void handOver();
+
+    std::mutex _mutex;
+    std::condition_variable _batchAvailable;
+    std::deque<std::vector<uint8_t>> _full;
+    std::deque<std::vector<uint8_t>> _free;
+    bool _threadShouldRun{true};
+    std::thread _writeThread;
+    void threadMain();
+
+    std::atomic<unsigned long> &_framesRecorded;
+    std::atomic<unsigned long> &_framesDropped;
+    std::atomic<unsigned long> &_bytesWritten;
+};
+
+}
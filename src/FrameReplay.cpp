@@ -0,0 +1,109 @@
+#include "FrameReplay.hpp"
+#include "FileHandleWrapper.hpp"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std::chrono;
+
+namespace webcam {
+
+FrameReplay::FrameReplay(const std::string &file) {
+    FileHandleWrapper fd(file, O_RDONLY);
+    struct stat status{};
+    if (fstat(fd.get(), &status) < 0 || static_cast<size_t>(status.st_size) < sizeof(RecordingHeader))
+    {
+        throw std::runtime_error(file + " is not a recording");
+    }
+    _mappingSize = static_cast<size_t>(status.st_size);
+    _mapping = mmap(nullptr, _mappingSize, PROT_READ, MAP_PRIVATE, fd.get(), 0);
+    if (_mapping == MAP_FAILED)
+    {
+        throw std::runtime_error("cannot map " + file);
+    }
+    // read ahead aggressively, frames are consumed front to back
+    madvise(_mapping, _mappingSize, MADV_SEQUENTIAL);
+
+    const auto *begin = static_cast<const uint8_t *>(_mapping);
+    const auto *header = reinterpret_cast<const RecordingHeader *>(begin);
+    if (std::memcmp(header->magic, RecordingHeader::magicValue, sizeof(header->magic)) != 0
+        || header->version != RecordingHeader::currentVersion)
+    {
+        munmap(_mapping, _mappingSize);
+        throw std::runtime_error(file + " is not a recording or from an incompatible version");
+    }
+    _serial.assign(header->serial, strnlen(header->serial, sizeof(header->serial)));
+
+    size_t position = sizeof(RecordingHeader);
+    while (position + sizeof(RecordedFrameHeader) <= _mappingSize)
+    {
+        const auto *frame = reinterpret_cast<const RecordedFrameHeader *>(begin + position);
+        const size_t recordSize = sizeof(RecordedFrameHeader)
+                                  + ((frame->dataSize + RecordedFrameHeader::alignment - 1)
+                                     & ~(RecordedFrameHeader::alignment - 1));
+        if (frame->magic != RecordedFrameHeader::magicValue
+            || static_cast<size_t>(frame->width) * frame->height * frame->channelCount != frame->dataSize
+            || position + recordSize > _mappingSize)
+        {
+            break;
+        }
+        _frames.push_back(frame);
+        position += recordSize;
+    }
+    if (position != _mappingSize)
+    {
+        std::cout << "Warning: " << file << " ends with " << _mappingSize - position
+                  << " bytes that are not a complete frame, ignored" << std::endl;
+    }
+}
+
+FrameReplay::~FrameReplay() {
+    munmap(_mapping, _mappingSize);
+}
+
+RawFrame FrameReplay::frame(size_t index) const {
+    const RecordedFrameHeader *header = _frames.at(index);
+    RawFrame frame;
+    frame.width = header->width;
+    frame.height = header->height;
+    frame.channelCount = header->channelCount;
+    // the pipeline only reads the frame, the mapping is read only anyway
+    frame.data = const_cast<RecordedFrameHeader *>(header + 1);
+    frame.offsetX = header->offsetX;
+    frame.offsetY = header->offsetY;
+    frame.binningX = header->binningX;
+    frame.binningY = header->binningY;
+    return frame;
+}
+
+FrameInfo FrameReplay::info(size_t index) const {
+    const RecordedFrameHeader *header = _frames.at(index);
+    FrameInfo info;
+    info.timestamp_us = header->timestamp_us;
+    info.expose_us = header->expose_us;
+    info.gain_dB = header->gain_dB;
+    return info;
+}
+
+void FrameReplay::play(const Handler &handler, bool realTime) const {
+    if (_frames.empty())
+    {
+        return;
+    }
+    const auto start = steady_clock::now();
+    const int64_t firstTimestamp_us = _frames.front()->timestamp_us;
+    for (size_t i = 0; i < _frames.size(); i++)
+    {
+        if (realTime)
+        {
+            std::this_thread::sleep_until(start + microseconds(_frames[i]->timestamp_us - firstTimestamp_us));
+        }
+        handler(frame(i), info(i));
+    }
+}
+
+}
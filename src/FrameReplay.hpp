@@ -0,0 +1,50 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+#include "FrameRecorder.hpp"
+#include "RawFrame.hpp"
+
+namespace webcam {
+
+/// \brief Plays back a file written by FrameRecorder.
+///
+/// The file is memory mapped, the frames handed out point straight into the
+/// mapping, so replay costs no copies and reproduces exactly what the camera
+/// delivered. A record cut off at the end (recording killed) is ignored.
+class FrameReplay {
+public:
+    using Handler = std::function<void(const RawFrame &frame, const FrameInfo &info)>;
+
+    explicit FrameReplay(const std::string &file);
+    ~FrameReplay();
+
+    FrameReplay(const FrameReplay &) = delete;
+    FrameReplay(FrameReplay &&) = delete;
+    FrameReplay &operator=(const FrameReplay &) = delete;
+    FrameReplay &operator=(FrameReplay &&) = delete;
+
+    /// \brief Serial of the camera the recording was made with.
+    const std::string &serial() const {
+        return _serial;
+    }
+
+    size_t frameCount() const {
+        return _frames.size();
+    }
+
+    RawFrame frame(size_t index) const;
+    FrameInfo info(size_t index) const;
+
+    /// \brief Calls handler for every frame in order, spaced like the recorded timestamps or,
+    /// with realTime false, as fast as handler returns.
+    void play(const Handler &handler, bool realTime) const;
+
+private:
+    void *_mapping{nullptr};
+    size_t _mappingSize{0};
+    std::string _serial;
+    std::vector<const RecordedFrameHeader *> _frames;
+};
+
+}
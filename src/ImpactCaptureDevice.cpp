@@ -0,0 +1,125 @@
+#include "ImpactCaptureDevice.hpp"
+#include "CameraHelper.hpp"
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+using namespace mvIMPACT::acquire;
+
+namespace webcam::Driver {
+
+ImpactCaptureDevice::ImpactCaptureDevice(Device *dev) : _dev(dev) {
+}
+
+void ImpactCaptureDevice::open() {
+    if (_functionInterface)
+    {
+        return;
+    }
+    std::cout << "Opening device...";
+    try
+    {
+        _dev->open();
+    }
+    catch (const ImpactAcquireException &e)
+    {
+        std::cout << "error" << std::endl;
+        // this e.g. might happen if the same device is already opened in another process...
+        std::cout << "An error occurred while opening the device " << _dev->serial.read()
+                  << "(error code: " << e.getErrorCodeAsString() << ").";
+        throw std::runtime_error("Error opening device");
+    }
+    std::cout << "ok" << std::endl;
+
+    try
+    {
+        _functionInterface = std::make_unique<FunctionInterface>(_dev);
+    }
+    catch (const ImpactAcquireException &e)
+    {
+        // this e.g. might happen if the same device is already opened in another process...
+        std::cout << "An error occurred while creating the function interface on device " << _dev->serial.read()
+                  << "(error code: " << e.getErrorCode() << "(" << e.getErrorCodeAsString() << ")). " << std::endl;
+        throw std::runtime_error("Error creating the function interface");
+    }
+}
+
+void ImpactCaptureDevice::close() {
+    _functionInterface.reset();
+    if (_dev->isOpen())
+    {
+        _dev->close();
+    }
+}
+
+bool ImpactCaptureDevice::isOpen() const {
+    return _functionInterface && _dev->isOpen();
+}
+
+bool ImpactCaptureDevice::queueRequest(int &number) {
+    return _functionInterface && _functionInterface->imageRequestSingle(nullptr, &number) == DMR_NO_ERROR;
+}
+
+bool ImpactCaptureDevice::waitForRequest(std::chrono::milliseconds timeout, webcam::CaptureRequest &request) {
+    if (!_functionInterface)
+    {
+        // as a device that delivers nothing
+        std::this_thread::sleep_for(timeout);
+        return false;
+    }
+    const int number = _functionInterface->imageRequestWaitFor(static_cast<int>(timeout.count()));
+    if (!_functionInterface->isRequestNrValid(number))
+    {
+        return false;
+    }
+    Request *mvRequest = _functionInterface->getRequest(number);
+    request.number = number;
+    request.ok = mvRequest->isOK();
+    request.result = mvRequest->requestResult.readS();
+    if (!request.ok)
+    {
+        request.frame = RawFrame();
+        return true;
+    }
+    request.frame.width = mvRequest->imageWidth.read();
+    request.frame.height = mvRequest->imageHeight.read();
+    // bytes, not channels: YUV422 has three channels in two bytes per pixel
+    request.frame.channelCount = mvRequest->imageBytesPerPixel.read();
+    request.frame.data = mvRequest->imageData.read();
+    request.frame.offsetX = mvRequest->imageOffsetX.read();
+    request.frame.offsetY = mvRequest->imageOffsetY.read();
+    request.timestamp_us = mvRequest->infoTimeStamp_us.read();
+    request.expose_us = mvRequest->infoExposeTime_us.read();
+    request.gain_dB = mvRequest->infoGain_dB.read();
+    return true;
+}
+
+void ImpactCaptureDevice::unlockRequest(int number) {
+    if (_functionInterface)
+    {
+        _functionInterface->getRequest(number)->unlock();
+    }
+}
+
+void ImpactCaptureDevice::resetRequests() {
+    if (_functionInterface)
+    {
+        _functionInterface->imageRequestReset(0, 0);
+    }
+}
+
+void ImpactCaptureDevice::startAcquisition() {
+    if (_functionInterface)
+    {
+        manuallyStartAcquisitionIfNeeded(_dev, *_functionInterface);
+    }
+}
+
+void ImpactCaptureDevice::stopAcquisition() {
+    if (_functionInterface)
+    {
+        manuallyStopAcquisitionIfNeeded(_dev, *_functionInterface);
+    }
+}
+
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <memory>
+#include <mvIMPACT_CPP/mvIMPACT_acquire.h>
+#include "CaptureDevice.hpp"
+
+namespace webcam::Driver {
+
+/// \brief CaptureDevice on the requests of an mvIMPACT device.
+class ImpactCaptureDevice : public webcam::CaptureDevice {
+public:
+    /// \param dev not opened yet, see open()
+    explicit ImpactCaptureDevice(mvIMPACT::acquire::Device *dev);
+
+    void open() override;
+    void close() override;
+    bool isOpen() const override;
+    bool queueRequest(int &number) override;
+    bool waitForRequest(std::chrono::milliseconds timeout, webcam::CaptureRequest &request) override;
+    void unlockRequest(int number) override;
+    void resetRequests() override;
+    void startAcquisition() override;
+    void stopAcquisition() override;
+
+private:
+    mvIMPACT::acquire::Device *_dev;
+    // only while the device is open
+    std::unique_ptr<mvIMPACT::acquire::FunctionInterface> _functionInterface;
+};
+
+}
@@ -0,0 +1,232 @@
+#include "JpegEncoder.hpp"
+#include "Metrics.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+using namespace std::chrono;
+
+namespace webcam {
+
+JpegEncoder::JpegEncoder(int width, int height) : _width(width), _height(height) {
+    _compressor.err = jpeg_std_error(&_error.manager);
+    _error.manager.error_exit = errorExit;
+    if (setjmp(_error.jump))
+    {
+        jpeg_destroy_compress(&_compressor);
+        throw std::runtime_error("cannot set up jpeg encoder");
+    }
+    jpeg_create_compress(&_compressor);
+    _compressor.client_data = this;
+
+    _destination.init_destination = initDestination;
+    _destination.empty_output_buffer = emptyOutputBuffer;
+    _destination.term_destination = termDestination;
+    _compressor.dest = &_destination;
+
+    _compressor.image_width = static_cast<JDIMENSION>(width);
+    _compressor.image_height = static_cast<JDIMENSION>(height);
+    _compressor.input_components = 3;
+    _compressor.in_color_space = JCS_YCbCr;
+    jpeg_set_defaults(&_compressor);
+    jpeg_set_colorspace(&_compressor, JCS_YCbCr);
+    // planes are passed in directly, 4:2:2 like the YUYV output
+    _compressor.raw_data_in = TRUE;
+    _compressor.dct_method = JDCT_IFAST;
+    _compressor.comp_info[0].h_samp_factor = 2;
+    _compressor.comp_info[0].v_samp_factor = 1;
+    for (int component = 1; component < 3; component++)
+    {
+        _compressor.comp_info[component].h_samp_factor = 1;
+        _compressor.comp_info[component].v_samp_factor = 1;
+    }
+
+    // grows on demand, a quarter of the raw size is plenty for typical quality settings
+    _buffer.resize(static_cast<size_t>(width) * height / 2);
+}
+
+JpegEncoder::~JpegEncoder() {
+    jpeg_destroy_compress(&_compressor);
+}
+
+void JpegEncoder::encode(const cv::Mat &i422, int quality) {
+    if (i422.rows != 2 * _height || i422.cols < _width || i422.type() != CV_8UC1)
+    {
+        throw std::invalid_argument("illegal jpeg input");
+    }
+    if (setjmp(_error.jump))
+    {
+        char message[JMSG_LENGTH_MAX];
+        (*_compressor.err->format_message)(reinterpret_cast<j_common_ptr>(&_compressor), message);
+        jpeg_abort_compress(&_compressor);
+        throw std::runtime_error(std::string("jpeg encoding failed: ") + message);
+    }
+
+    jpeg_set_quality(&_compressor, quality, TRUE);
+    jpeg_start_compress(&_compressor, TRUE);
+
+    const int chromaOffset = i422.cols / 2;
+    JSAMPROW yRows[DCTSIZE];
+    JSAMPROW uRows[DCTSIZE];
+    JSAMPROW vRows[DCTSIZE];
+    JSAMPARRAY planes[3] = {yRows, uRows, vRows};
+    while (_compressor.next_scanline < _compressor.image_height)
+    {
+        for (int i = 0; i < DCTSIZE; i++)
+        {
+            // the last MCU row is padded by repeating the last image row
+            const int row = std::min(static_cast<int>(_compressor.next_scanline) + i, _height - 1);
+            yRows[i] = const_cast<JSAMPROW>(i422.ptr(row));
+            uRows[i] = const_cast<JSAMPROW>(i422.ptr(_height + row));
+            vRows[i] = uRows[i] + chromaOffset;
+        }
+        jpeg_write_raw_data(&_compressor, planes, DCTSIZE);
+    }
+    jpeg_finish_compress(&_compressor);
+}
+
+void JpegEncoder::errorExit(j_common_ptr compressor) {
+    // the default handler calls exit()
+    std::longjmp(reinterpret_cast<ErrorManager *>(compressor->err)->jump, 1);
+}
+
+void JpegEncoder::initDestination(j_compress_ptr compressor) {
+    auto *self = static_cast<JpegEncoder *>(compressor->client_data);
+    compressor->dest->next_output_byte = self->_buffer.data();
+    compressor->dest->free_in_buffer = self->_buffer.size();
+}
+
+boolean JpegEncoder::emptyOutputBuffer(j_compress_ptr compressor) {
+    // called with the whole buffer used up
+    auto *self = static_cast<JpegEncoder *>(compressor->client_data);
+    const size_t used = self->_buffer.size();
+    self->_buffer.resize(used * 2);
+    compressor->dest->next_output_byte = self->_buffer.data() + used;
+    compressor->dest->free_in_buffer = self->_buffer.size() - used;
+    return TRUE;
+}
+
+void JpegEncoder::termDestination(j_compress_ptr compressor) {
+    auto *self = static_cast<JpegEncoder *>(compressor->client_data);
+    self->_size = self->_buffer.size() - compressor->dest->free_in_buffer;
+}
+
+JpegEncoderPool::JpegEncoderPool(const OutputConfig &config, Output output)
+    : _config(config), _output(std::move(output)),
+      _frameBudget(config.jpegBitrate_kbps == 0 ? 0
+                   : static_cast<size_t>(config.jpegBitrate_kbps) * 1000 / 8 / config.framesPerSecond),
+      _quality(config.jpegQuality),
+      _encodeTimeMetric(Metrics::global().gauge(config.device + ".jpeg.encode_ms")),
+      _frameBytesMetric(Metrics::global().gauge(config.device + ".jpeg.bytes")),
+      _qualityMetric(Metrics::global().gauge(config.device + ".jpeg.quality")),
+      _droppedMetric(Metrics::global().counter(config.device + ".jpeg.framesDropped")) {
+    if (config.jpegQuality < 1 || config.jpegQuality > 100)
+    {
+        throw std::runtime_error("Illegal jpeg quality");
+    }
+
+    // all workers exist before the first thread starts, they reference their slot in the vector
+    _workers.resize(std::max(config.jpegThreads, 1u));
+    for (auto &worker : _workers)
+    {
+        worker.encoder = std::make_unique<JpegEncoder>(config.width, config.height);
+    }
+    for (auto &worker : _workers)
+    {
+        worker.thread = std::thread(&JpegEncoderPool::workerMain, this, std::ref(worker));
+    }
+}
+
+JpegEncoderPool::~JpegEncoderPool() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _threadShouldRun = false;
+    }
+    _frameAvailable.notify_all();
+    for (auto &worker : _workers)
+    {
+        worker.thread.join();
+    }
+}
+
+void JpegEncoderPool::submit(const cv::Mat &i422) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_hasPending)
+        {
+            // all encoders are busy, the newer frame wins
+            _droppedMetric++;
+        }
+        i422.copyTo(_pending);
+        _pendingSequence++;
+        _hasPending = true;
+    }
+    _frameAvailable.notify_one();
+}
+
+void JpegEncoderPool::workerMain(Worker &worker) {
+    TRACE_THREAD_NAME(_config.device + " jpeg");
+    while (true)
+    {
+        unsigned long sequence;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _frameAvailable.wait(lock, [this] { return _hasPending || !_threadShouldRun; });
+            if (!_threadShouldRun)
+            {
+                return;
+            }
+            // swap instead of copy, the next submit() reuses the buffer this worker had
+            cv::swap(_pending, worker.input);
+            sequence = _pendingSequence;
+            _hasPending = false;
+        }
+
+        const auto start = steady_clock::now();
+        try
+        {
+            TRACE_SCOPE("jpeg encode", static_cast<int64_t>(sequence));
+            worker.encoder->encode(worker.input, _quality);
+        }
+        catch (const std::exception &e)
+        {
+            std::cout << _config.device << ": " << e.what() << std::endl;
+            continue;
+        }
+        _encodeTimeMetric = duration<double, std::milli>(steady_clock::now() - start).count();
+        deliver(sequence, *worker.encoder);
+    }
+}
+
+void JpegEncoderPool::deliver(unsigned long sequence, const JpegEncoder &encoder) {
+    std::lock_guard<std::mutex> lock(_outputMutex);
+    if (sequence <= _lastDelivered)
+    {
+        // a newer frame overtook this one
+        _droppedMetric++;
+        return;
+    }
+    _lastDelivered = sequence;
+    _output(encoder.data(), encoder.size());
+    _frameBytesMetric = static_cast<double>(encoder.size());
+
+    if (_frameBudget != 0)
+    {
+        // coarse steps down to get under budget quickly, fine steps back up
+        int quality = _quality;
+        if (encoder.size() > _frameBudget)
+        {
+            quality = std::max(quality - 5, 20);
+        }
+        else if (encoder.size() < _frameBudget * 7 / 10 && quality < _config.jpegQuality)
+        {
+            quality++;
+        }
+        _quality = quality;
+    }
+    _qualityMetric = _quality;
+}
+
+}
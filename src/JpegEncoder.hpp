@@ -0,0 +1,120 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <csetjmp>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <jpeglib.h>
+#include <opencv2/core.hpp>
+#include "OutputConfig.hpp"
+
+namespace webcam {
+
+/// \brief libjpeg compressor that is set up once and reused for every frame.
+///
+/// Takes the planar 4:2:2 image FramePipeline produces for PixelFormat::MJPEG
+/// and feeds it to libjpeg in raw data mode, so there is no color conversion
+/// and no RGB copy. The output buffer grows to the largest frame seen and is
+/// kept.
+class JpegEncoder {
+public:
+    JpegEncoder(int width, int height);
+    ~JpegEncoder();
+
+    JpegEncoder(const JpegEncoder &) = delete;
+    JpegEncoder(JpegEncoder &&) = delete;
+    JpegEncoder &operator=(const JpegEncoder &) = delete;
+    JpegEncoder &operator=(JpegEncoder &&) = delete;
+
+    /// \brief Encodes i422 (layout see FramePipeline::process), the result is valid until the next call.
+    void encode(const cv::Mat &i422, int quality);
+
+    const uint8_t *data() const {
+        return _buffer.data();
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+private:
+    struct ErrorManager {
+        jpeg_error_mgr manager;
+        std::jmp_buf jump;
+    };
+
+    int _width;
+    int _height;
+    jpeg_compress_struct _compressor{};
+    ErrorManager _error{};
+    jpeg_destination_mgr _destination{};
+    std::vector<uint8_t> _buffer;
+    size_t _size{0};
+
+    static void errorExit(j_common_ptr compressor);
+    static void initDestination(j_compress_ptr compressor);
+    static boolean emptyOutputBuffer(j_compress_ptr compressor);
+    static void termDestination(j_compress_ptr compressor);
+};
+
+/// \brief Encodes frames on several threads so JPEG encoding doesn't bound the frame rate.
+///
+/// submit() copies the frame and returns. Encoded frames are handed to the
+/// output function in capture order, a frame that finishes after a newer one
+/// was already delivered is dropped, as is a frame that is still waiting when
+/// the next one is submitted.
+class JpegEncoderPool {
+public:
+    using Output = std::function<void(const uint8_t *data, size_t size)>;
+
+    JpegEncoderPool(const OutputConfig &config, Output output);
+    ~JpegEncoderPool();
+
+    JpegEncoderPool(const JpegEncoderPool &) = delete;
+    JpegEncoderPool(JpegEncoderPool &&) = delete;
+    JpegEncoderPool &operator=(const JpegEncoderPool &) = delete;
+    JpegEncoderPool &operator=(JpegEncoderPool &&) = delete;
+
+    void submit(const cv::Mat &i422);
+
+private:
+    struct Worker {
+        std::unique_ptr<JpegEncoder> encoder;
+        cv::Mat input;
+        std::thread thread;
+    };
+
+    const OutputConfig _config;
+    Output _output;
+    // per frame budget for the rate control, 0 if off
+    const size_t _frameBudget;
+    std::atomic<int> _quality;
+
+    std::mutex _mutex;
+    std::condition_variable _frameAvailable;
+    cv::Mat _pending;
+    unsigned long _pendingSequence{0};
+    bool _hasPending{false};
+    bool _threadShouldRun{true};
+
+    std::mutex _outputMutex;
+    unsigned long _lastDelivered{0};
+
+    std::vector<Worker> _workers;
+
+    std::atomic<double> &_encodeTimeMetric;
+    std::atomic<double> &_frameBytesMetric;
+    std::atomic<double> &_qualityMetric;
+    std::atomic<unsigned long> &_droppedMetric;
+
+    void workerMain(Worker &worker);
+    void deliver(unsigned long sequence, const JpegEncoder &encoder);
+};
+
+}
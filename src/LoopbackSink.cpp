@@ -0,0 +1,276 @@
+#include "LoopbackSink.hpp"
+#include "Metrics.hpp"
+#include "Trace.hpp"
+#include <stdexcept>
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <poll.h>
+
+#if __has_include(<linux/v4l2loopback.h>)
+#include <linux/v4l2loopback.h>
+#endif
+
+#ifndef V4L2_EVENT_PRI_CLIENT_USAGE
+// from v4l2loopback.h (>= 0.12.6), carries the number of other clients that have the device open
+#define V4L2_EVENT_PRI_CLIENT_USAGE V4L2_EVENT_PRIVATE_START
+struct v4l2_event_client_usage {
+    __u32 count;
+};
+#endif
+
+using namespace std::chrono;
+
+namespace webcam {
+
+LoopbackSink::LoopbackSink(const OutputConfig &config)
+    : _device(config.device), _dev_fd(config.device, O_RDWR), _videoFormat{},
+      _frameInterval(config.framesPerSecond == 0 ? nanoseconds(0)
+                                                 : nanoseconds(seconds(1)) / config.framesPerSecond),
+      _nextAccept(steady_clock::now()),
+      _framesDropped(Metrics::global().counter(config.device + ".framesDropped")),
+      _framesRepeated(Metrics::global().counter(config.device + ".framesRepeated")),
+      _writeErrors(Metrics::global().counter(config.device + ".writeErrors")) {
+    const unsigned int frameWidth = config.width;
+    const unsigned int frameHeight = config.height;
+    const unsigned int framesPerSecond = config.framesPerSecond;
+    if (frameHeight == 0 || frameWidth == 0)
+    {
+        throw std::runtime_error("Illegal frame heigh/width");
+    }
+    if (framesPerSecond == 0)
+    {
+        throw std::runtime_error("Illegal frame rate");
+    }
+
+    _videoFormat.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    if (ioctl(_dev_fd.get(), VIDIOC_G_FMT, &_videoFormat) < 0)
+    {
+        throw std::runtime_error("cannot setup video device");
+    }
+    _videoFormat.fmt.pix.width = frameWidth;
+    _videoFormat.fmt.pix.height = frameHeight;
+    // for MJPEG this is the largest frame we may write, a JPEG never gets near the raw size
+    _videoFormat.fmt.pix.pixelformat = config.format == PixelFormat::MJPEG ? V4L2_PIX_FMT_MJPEG : V4L2_PIX_FMT_YUYV;
+    _videoFormat.fmt.pix.sizeimage = 2 * frameWidth * frameHeight;
+    _videoFormat.fmt.pix.field = V4L2_FIELD_NONE;
+    if (ioctl(_dev_fd.get(), VIDIOC_S_FMT, &_videoFormat) < 0)
+    {
+        throw std::runtime_error("cannot setup video device");
+    }
+
+    // announce the rate we are going to pace at, consumers use this to size their buffers/timers
+    v4l2_streamparm streamParm{};
+    streamParm.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    streamParm.parm.output.timeperframe.numerator = 1;
+    streamParm.parm.output.timeperframe.denominator = framesPerSecond;
+    if (ioctl(_dev_fd.get(), VIDIOC_S_PARM, &streamParm) < 0)
+    {
+        std::cout << "Warning: video device does not accept a frame interval of 1/" << framesPerSecond
+                  << "s, output is paced anyway" << std::endl;
+    }
+
+    _pendingFrame.resize(frameSize());
+    _currentFrame.resize(frameSize());
+    _writeThread = std::thread(&LoopbackSink::threadMain, this);
+
+    if (subscribeConsumerEvents())
+    {
+        _monitorThread = std::thread(&LoopbackSink::monitorMain, this);
+    }
+    else
+    {
+        std::cout << "Warning: v4l2loopback doesn't report its clients (needs >= 0.12.6), "
+                     "processing frames even when nobody is watching" << std::endl;
+    }
+}
+
+LoopbackSink::~LoopbackSink() {
+    {
+        // under the mutex, or the writer could check its wait condition, miss the notify and block forever
+        std::lock_guard<std::mutex> lock(_frameMutex);
+        _threadShouldRun = false;
+    }
+    _frameCondition.notify_all();
+    if (_writeThread.joinable())
+    {
+        _writeThread.join();
+    }
+    if (_monitorThread.joinable())
+    {
+        _monitorThread.join();
+    }
+}
+
+bool LoopbackSink::wantsFrame() {
+    if (_primed && !_consumerAttached)
+    {
+        return false;
+    }
+
+    const auto now = steady_clock::now();
+    // accept up to half an interval early so sensor jitter doesn't make us drop every other frame
+    if (now + _frameInterval / 2 < _nextAccept)
+    {
+        return false;
+    }
+    _nextAccept += _frameInterval;
+    if (_nextAccept < now)
+    {
+        // fell behind (camera slower than output rate), don't try to catch up
+        _nextAccept = now + _frameInterval;
+    }
+    return true;
+}
+
+void LoopbackSink::submit(const uint8_t *data, size_t size) {
+    TRACE_SCOPE("sink submit");
+    const bool compressed = _videoFormat.fmt.pix.pixelformat == V4L2_PIX_FMT_MJPEG;
+    if (compressed ? size > frameSize() : size != frameSize())
+    {
+        throw std::runtime_error("yuv array incorrect size");
+    }
+    {
+        std::lock_guard<std::mutex> lock(_frameMutex);
+        if (_hasPending)
+        {
+            _framesDropped++;
+        }
+        std::memcpy(_pendingFrame.data(), data, size);
+        _pendingSize = size;
+        _hasPending = true;
+    }
+    _frameCondition.notify_one();
+}
+
+void LoopbackSink::threadMain() {
+    TRACE_THREAD_NAME(_device + " writer");
+    // don't write anything before the first real frame arrived
+    {
+        std::unique_lock<std::mutex> lock(_frameMutex);
+        _frameCondition.wait(lock, [this] { return _hasPending || !_threadShouldRun; });
+    }
+
+    auto nextTick = steady_clock::now();
+    while (_threadShouldRun)
+    {
+        if (_primed && !_consumerAttached)
+        {
+            std::unique_lock<std::mutex> lock(_frameMutex);
+            _frameCondition.wait(lock, [this] { return _consumerAttached || !_threadShouldRun; });
+            // repeat the last frame right away so a new consumer doesn't wait for the camera to restart
+            nextTick = steady_clock::now();
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_frameMutex);
+            if (_hasPending)
+            {
+                std::swap(_pendingFrame, _currentFrame);
+                _currentSize = _pendingSize;
+                _hasPending = false;
+                _hasCurrent = true;
+            }
+            else
+            {
+                _framesRepeated++;
+            }
+        }
+
+        if (_hasCurrent)
+        {
+            TRACE_SCOPE("write");
+            const ssize_t written = write(_dev_fd.get(), _currentFrame.data(), _currentSize);
+            if (written == static_cast<ssize_t>(_currentSize))
+            {
+                _primed = true;
+                _writeFailing = false;
+            }
+            else
+            {
+                _writeErrors++;
+                // once per run of failures, the writer retries every tick
+                if (!_writeFailing)
+                {
+                    std::cout << _device << ": writing a frame failed ("
+                              << (written < 0 ? std::strerror(errno) : "short write") << ")" << std::endl;
+                    _writeFailing = true;
+                }
+            }
+        }
+
+        const auto now = steady_clock::now();
+        nextTick += _frameInterval;
+        if (nextTick < now)
+        {
+            // a write took longer than a whole interval, restart the schedule instead of bursting
+            nextTick = now + _frameInterval;
+        }
+        std::this_thread::sleep_until(nextTick);
+    }
+}
+
+void LoopbackSink::setConsumerListener(std::function<void(bool)> listener) {
+    std::lock_guard<std::mutex> lock(_listenerMutex);
+    _consumerListener = std::move(listener);
+    if (_consumerListener)
+    {
+        _consumerListener(_reportedActive);
+    }
+}
+
+bool LoopbackSink::subscribeConsumerEvents() {
+    v4l2_event_subscription subscription{};
+    subscription.type = V4L2_EVENT_PRI_CLIENT_USAGE;
+    subscription.flags = V4L2_EVENT_SUB_FL_SEND_INITIAL;
+    return ioctl(_dev_fd.get(), VIDIOC_SUBSCRIBE_EVENT, &subscription) >= 0;
+}
+
+void LoopbackSink::monitorMain() {
+    TRACE_THREAD_NAME(_device + " monitor");
+    pollfd pfd{};
+    pfd.fd = _dev_fd.get();
+    pfd.events = POLLPRI;
+
+    while (_threadShouldRun)
+    {
+        // short timeout so shutdown and priming are noticed without an event
+        if (poll(&pfd, 1, 100) > 0 && (pfd.revents & POLLPRI))
+        {
+            // the fd is blocking, so only dequeue as many events as the driver says are pending
+            v4l2_event event{};
+            do
+            {
+                if (ioctl(_dev_fd.get(), VIDIOC_DQEVENT, &event) < 0)
+                {
+                    break;
+                }
+                if (event.type == V4L2_EVENT_PRI_CLIENT_USAGE)
+                {
+                    v4l2_event_client_usage usage{};
+                    std::memcpy(&usage, &event.u, sizeof(usage));
+                    std::lock_guard<std::mutex> lock(_frameMutex);
+                    _consumerAttached = usage.count > 0;
+                }
+            } while (event.pending > 0);
+            _frameCondition.notify_all();
+        }
+
+        const bool active = _consumerAttached || !_primed;
+        std::lock_guard<std::mutex> lock(_listenerMutex);
+        if (active != _reportedActive)
+        {
+            _reportedActive = active;
+            std::cout << (active ? "Consumer attached, resuming" : "No consumer, going idle") << std::endl;
+            if (_consumerListener)
+            {
+                _consumerListener(active);
+            }
+        }
+    }
+}
+
+}
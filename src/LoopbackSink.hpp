@@ -0,0 +1,105 @@
+#pragma once
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <linux/videodev2.h>
+#include "FileHandleWrapper.hpp"
+#include "OutputConfig.hpp"
+
+namespace webcam {
+
+/// \brief Paced YUYV/MJPEG writer for a v4l2loopback output device.
+///
+/// Frames handed to submit() are not written immediately. A writer thread
+/// ticks at the configured output rate against the monotonic clock and writes
+/// whatever frame is newest at that moment, so consumers see an even frame
+/// interval: frames arriving faster than the tick are dropped, gaps are
+/// filled by repeating the last frame.
+///
+/// The sink also watches whether anyone besides us has the device open. While
+/// nobody does, nothing is written and wantsFrame() returns false.
+class LoopbackSink {
+public:
+    explicit LoopbackSink(const OutputConfig &config);
+    ~LoopbackSink();
+
+    LoopbackSink(const LoopbackSink &) = delete;
+    LoopbackSink(LoopbackSink &&) = delete;
+    LoopbackSink &operator=(const LoopbackSink &) = delete;
+    LoopbackSink &operator=(LoopbackSink &&) = delete;
+
+    /// \brief Returns true if a frame captured now would make it to the device.
+    /// Lets the capture side skip processing frames the pacer would drop anyway.
+    bool wantsFrame();
+
+    /// \brief Hands a finished frame of frameSize() bytes (MJPEG: at most) to the pacer.
+    void submit(const uint8_t *data, size_t size);
+
+    /// \brief True while a consumer has the device open (or if the driver can't tell us).
+    bool hasConsumer() const {
+        return _consumerAttached;
+    }
+
+    /// \brief Registers a function that is called from the monitor thread whenever the sink
+    /// changes between idle (no consumer) and active. It is called once right away with the current state.
+    void setConsumerListener(std::function<void(bool)> listener);
+
+    size_t frameSize() const {
+        return _videoFormat.fmt.pix.sizeimage;
+    }
+
+    std::chrono::nanoseconds frameInterval() const {
+        return _frameInterval;
+    }
+
+private:
+    const std::string _device;
+    FileHandleWrapper _dev_fd;
+    v4l2_format _videoFormat;
+    const std::chrono::nanoseconds _frameInterval;
+
+    // next capture time that is accepted by wantsFrame()
+    std::chrono::steady_clock::time_point _nextAccept;
+
+    std::mutex _frameMutex;
+    std::condition_variable _frameCondition;
+    std::vector<uint8_t> _pendingFrame;
+    std::vector<uint8_t> _currentFrame;
+    // bytes used in the buffers above, less than frameSize() for MJPEG
+    size_t _pendingSize{0};
+    size_t _currentSize{0};
+    bool _hasPending{false};
+    bool _hasCurrent{false};
+
+    // <device>.framesDropped/.framesRepeated/.writeErrors in Metrics
+    std::atomic<unsigned long> &_framesDropped;
+    std::atomic<unsigned long> &_framesRepeated;
+    std::atomic<unsigned long> &_writeErrors;
+    // only touched by the writer thread
+    bool _writeFailing{false};
+
+    // cleared with _frameMutex held, the writer waits on _frameCondition for it
+    std::atomic<bool> _threadShouldRun{true};
+    std::thread _writeThread;
+    void threadMain();
+
+    // consumer detection through v4l2loopback's client usage event
+    std::atomic<bool> _consumerAttached{true};
+    // set after the first frame was written, with exclusive_caps=1 the device isn't
+    // visible as a capture device before that so we must not go idle earlier
+    std::atomic<bool> _primed{false};
+    std::mutex _listenerMutex;
+    std::function<void(bool)> _consumerListener;
+    bool _reportedActive{true};
+    std::thread _monitorThread;
+    bool subscribeConsumerEvents();
+    void monitorMain();
+};
+
+}
@@ -0,0 +1,42 @@
+#include "Metrics.hpp"
+
+namespace webcam {
+
+Metrics &Metrics::global() {
+    static Metrics metrics;
+    return metrics;
+}
+
+std::atomic<unsigned long> &Metrics::counter(const std::string &name) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto &value = _counters[name];
+    if (!value)
+    {
+        value = std::make_unique<std::atomic<unsigned long>>(0);
+    }
+    return *value;
+}
+
+std::atomic<double> &Metrics::gauge(const std::string &name) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto &value = _gauges[name];
+    if (!value)
+    {
+        value = std::make_unique<std::atomic<double>>(0.0);
+    }
+    return *value;
+}
+
+void Metrics::print(std::ostream &stream) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (const auto &[name, value] : _counters)
+    {
+        stream << name << " " << value->load() << std::endl;
+    }
+    for (const auto &[name, value] : _gauges)
+    {
+        stream << name << " " << value->load() << std::endl;
+    }
+}
+
+}
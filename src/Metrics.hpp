@@ -0,0 +1,30 @@
+#pragma once
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+namespace webcam {
+
+/// \brief Process wide named counters and gauges.
+///
+/// Look a value up once (the reference stays valid for the whole run) and
+/// update it from any thread. The "metrics" command prints all of them.
+class Metrics {
+public:
+    static Metrics &global();
+
+    std::atomic<unsigned long> &counter(const std::string &name);
+    std::atomic<double> &gauge(const std::string &name);
+
+    void print(std::ostream &stream) const;
+
+private:
+    mutable std::mutex _mutex;
+    std::map<std::string, std::unique_ptr<std::atomic<unsigned long>>> _counters;
+    std::map<std::string, std::unique_ptr<std::atomic<double>>> _gauges;
+};
+
+}
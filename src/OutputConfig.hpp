@@ -0,0 +1,27 @@
+#pragma once
+#include <string>
+
+namespace webcam {
+
+enum class PixelFormat {
+    YUYV,
+    // encoded from planar 4:2:2, see JpegEncoder
+    MJPEG
+};
+
+/// \brief Everything about one loopback output.
+struct OutputConfig {
+    std::string device{"/dev/video0"};
+    unsigned int width{640};
+    unsigned int height{480};
+    unsigned int framesPerSecond{30};
+    PixelFormat format{PixelFormat::YUYV};
+
+    // MJPEG only
+    int jpegQuality{85};
+    unsigned int jpegThreads{2};
+    // 0 means fixed quality, otherwise the quality is lowered while frames don't fit this budget
+    unsigned int jpegBitrate_kbps{0};
+};
+
+}
@@ -0,0 +1,291 @@
+#include "PixelKernels.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <random>
+#include <stdexcept>
+#include <strings.h>
+#include <libyuv.h>
+
+namespace webcam {
+
+namespace baseline {
+extern const PixelKernels kernels;
+}
+#ifdef WEBCAM_CPU_DISPATCH
+namespace sse4 {
+extern const PixelKernels kernels;
+}
+namespace avx2 {
+extern const PixelKernels kernels;
+}
+namespace avx512 {
+extern const PixelKernels kernels;
+}
+#endif
+
+namespace {
+
+constexpr CpuLevel allLevels[] = {CpuLevel::Baseline, CpuLevel::SSE4, CpuLevel::AVX2, CpuLevel::AVX512};
+
+// null until the first use picks the level matching the CPU
+std::atomic<const PixelKernels *> activeKernels{nullptr};
+std::atomic<CpuLevel> activeLevel{CpuLevel::Baseline};
+
+bool supported(CpuLevel level) {
+    if (level == CpuLevel::Baseline)
+    {
+        return true;
+    }
+#ifdef WEBCAM_CPU_DISPATCH
+    __builtin_cpu_init();
+    switch (level)
+    {
+        case CpuLevel::Baseline:
+            return true;
+        case CpuLevel::SSE4:
+            return __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt");
+        case CpuLevel::AVX2:
+            // every flag the AVX2 variant is built with
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && __builtin_cpu_supports("bmi")
+                   && __builtin_cpu_supports("bmi2") && __builtin_cpu_supports("f16c");
+        case CpuLevel::AVX512:
+            return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")
+                   && __builtin_cpu_supports("avx512vl") && supported(CpuLevel::AVX2);
+    }
+#endif
+    return false;
+}
+
+// what libyuv may use at a level
+int libyuvCpuFlags(CpuLevel level) {
+    int disabled = 0;
+    if (level < CpuLevel::AVX512)
+    {
+        disabled |= libyuv::kCpuHasAVX512BW | libyuv::kCpuHasAVX512VL;
+    }
+    if (level < CpuLevel::AVX2)
+    {
+        disabled |= libyuv::kCpuHasAVX | libyuv::kCpuHasAVX2 | libyuv::kCpuHasFMA3 | libyuv::kCpuHasF16C;
+    }
+    if (level < CpuLevel::SSE4)
+    {
+        disabled |= libyuv::kCpuHasSSSE3 | libyuv::kCpuHasSSE41 | libyuv::kCpuHasSSE42;
+    }
+    return ~disabled;
+}
+
+// 17 points per axis with random entries and curves, so every corner of every cell counts
+const ColorLut &testLut() {
+    constexpr int size = 17;
+    static std::vector<uint16_t> table(4 * size * size * size);
+    static std::vector<uint16_t> positions(256);
+    static std::vector<uint8_t> curves(3 * ColorLut::curveSize);
+    static const ColorLut lut = [] {
+        std::mt19937 random(2);
+        std::uniform_int_distribution<int> entry(0, 255 * 256);
+        for (auto &value : table)
+        {
+            value = static_cast<uint16_t>(entry(random));
+        }
+        for (auto &value : curves)
+        {
+            value = static_cast<uint8_t>(random());
+        }
+        for (int value = 0; value < 256; value++)
+        {
+            const int position = (value * (size - 1) * 256 + 127) / 255;
+            positions[value] = static_cast<uint16_t>(position == (size - 1) * 256 ? (size - 2) * 512 + 256
+                                                     : (position >> 8) * 512 + (position & 255));
+        }
+        return ColorLut{table.data(), size, positions.data(), curves.data()};
+    }();
+    return lut;
+}
+
+// 0.5 to 2.5, so some pixels saturate
+std::vector<uint16_t> gainsFrom(const std::vector<uint8_t> &bytes, int length) {
+    std::vector<uint16_t> gains(length);
+    for (int i = 0; i < length; i++)
+    {
+        gains[i] = static_cast<uint16_t>(128 + 2 * bytes[i]);
+    }
+    return gains;
+}
+
+}
+
+const PixelKernels &pixelKernels() {
+    const PixelKernels *kernels = activeKernels.load(std::memory_order_acquire);
+    if (kernels == nullptr)
+    {
+        const CpuLevel level = detectCpuLevel();
+        activeLevel = level;
+        kernels = &pixelKernels(level);
+        activeKernels.store(kernels, std::memory_order_release);
+    }
+    return *kernels;
+}
+
+const PixelKernels &pixelKernels(CpuLevel level) {
+    if (!supported(level))
+    {
+        throw std::invalid_argument(std::string(name(level)) + " is not supported by this CPU or build");
+    }
+    switch (level)
+    {
+#ifdef WEBCAM_CPU_DISPATCH
+        case CpuLevel::SSE4:
+            return sse4::kernels;
+        case CpuLevel::AVX2:
+            return avx2::kernels;
+        case CpuLevel::AVX512:
+            return avx512::kernels;
+#endif
+        default:
+            return baseline::kernels;
+    }
+}
+
+CpuLevel detectCpuLevel() {
+    return supportedCpuLevels().back();
+}
+
+std::vector<CpuLevel> supportedCpuLevels() {
+    std::vector<CpuLevel> levels;
+    for (const CpuLevel level : allLevels)
+    {
+        if (supported(level))
+        {
+            levels.push_back(level);
+        }
+    }
+    return levels;
+}
+
+CpuLevel cpuLevel() {
+    pixelKernels();
+    return activeLevel;
+}
+
+void setCpuLevel(CpuLevel level) {
+    const PixelKernels &kernels = pixelKernels(level);
+    activeLevel = level;
+    activeKernels.store(&kernels, std::memory_order_release);
+    libyuv::MaskCpuFlags(libyuvCpuFlags(level));
+}
+
+CpuLevel parseCpuLevel(const std::string &text) {
+    for (const CpuLevel level : allLevels)
+    {
+        if (strcasecmp(text.c_str(), name(level)) == 0)
+        {
+            return level;
+        }
+    }
+    throw std::invalid_argument("has to be baseline, sse4, avx2 or avx512");
+}
+
+const char *name(CpuLevel level) {
+    switch (level)
+    {
+        case CpuLevel::Baseline:
+            return "baseline";
+        case CpuLevel::SSE4:
+            return "sse4";
+        case CpuLevel::AVX2:
+            return "avx2";
+        case CpuLevel::AVX512:
+            return "avx512";
+    }
+    return "";
+}
+
+bool selfTestPixelKernels(std::ostream &out) {
+    // odd lengths leave a scalar tail after the vector loop, the large one is a full frame row
+    constexpr int lengths[] = {1, 3, 15, 17, 63, 65, 752, 1501};
+    constexpr int maxLength = 1501;
+    std::mt19937 random(1);
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::vector<uint8_t> a(4 * maxLength);
+    std::vector<uint8_t> b(4 * maxLength);
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        a[i] = static_cast<uint8_t>(byte(random));
+        // mostly close to a, as consecutive frames and blurred images are, so every branch is taken
+        b[i] = static_cast<uint8_t>(i % 3 == 0 ? byte(random) : std::clamp(a[i] + byte(random) % 7 - 3, 0, 255));
+    }
+
+    // fills the output of one kernel run
+    using Run = void (*)(const PixelKernels &, const std::vector<uint8_t> &, const std::vector<uint8_t> &,
+                         std::vector<uint8_t> &, int);
+    const std::pair<const char *, Run> runs[] = {
+        {"denoiseGray", [](const PixelKernels &k, const auto &cur, const auto &prev, auto &result, int length) {
+            k.denoiseGray(cur.data(), prev.data(), result.data(), length, 100);
+        }},
+        {"denoiseBGRA", [](const PixelKernels &k, const auto &cur, const auto &prev, auto &result, int length) {
+            k.denoiseBGRA(cur.data(), prev.data(), result.data(), length, 100);
+        }},
+        {"packGrayYUY2", [](const PixelKernels &k, const auto &gray, const auto &, auto &result, int length) {
+            k.packGrayYUY2(gray.data(), result.data(), length);
+        }},
+        {"sharpen", [](const PixelKernels &k, const auto &img, const auto &blurred, auto &result, int length) {
+            k.sharpen(img.data(), blurred.data(), result.data(), 4 * length, 2, 1);
+        }},
+        {"gainGray", [](const PixelKernels &k, const auto &image, const auto &other, auto &result, int length) {
+            std::copy(image.begin(), image.end(), result.begin());
+            k.gainGray(result.data(), gainsFrom(other, length).data(), length);
+        }},
+        {"gainBGRA", [](const PixelKernels &k, const auto &image, const auto &other, auto &result, int length) {
+            std::copy(image.begin(), image.end(), result.begin());
+            k.gainBGRA(result.data(), gainsFrom(other, length).data(), length);
+        }},
+        {"lutBGRA", [](const PixelKernels &k, const auto &bgra, const auto &, auto &result, int length) {
+            k.lutBGRA(bgra.data(), result.data(), length, testLut());
+        }},
+    };
+
+    bool passed = true;
+    const PixelKernels &reference = pixelKernels(CpuLevel::Baseline);
+    std::vector<uint8_t> expected(4 * maxLength);
+    std::vector<uint8_t> result(4 * maxLength);
+    for (const CpuLevel level : supportedCpuLevels())
+    {
+        const PixelKernels &kernels = pixelKernels(level);
+        bool levelPassed = true;
+        for (const auto &[kernel, run] : runs)
+        {
+            for (const int length : lengths)
+            {
+                std::fill(expected.begin(), expected.end(), 0);
+                std::fill(result.begin(), result.end(), 0);
+                run(reference, a, b, expected, length);
+                run(kernels, a, b, result, length);
+                if (expected != result)
+                {
+                    out << name(level) << ": " << kernel << " differs from baseline at " << length << " pixels"
+                        << std::endl;
+                    levelPassed = false;
+                }
+            }
+        }
+
+        // a 752 pixel wide BGRA frame of 400 rows, as the undistorted region
+        const auto start = std::chrono::steady_clock::now();
+        for (int row = 0; row < 400; row++)
+        {
+            kernels.denoiseBGRA(a.data(), b.data(), result.data(), 752, 100);
+            kernels.sharpen(a.data(), b.data(), result.data(), 4 * 752, 2, 1);
+        }
+        const double frame_us = std::chrono::duration<double, std::micro>(
+                std::chrono::steady_clock::now() - start).count();
+        out << std::left << std::setw(10) << name(level) << std::right << (levelPassed ? "ok" : "FAILED")
+            << ", denoise + sharpen of a frame " << std::fixed << std::setprecision(0) << frame_us << " us"
+            << std::endl;
+        passed = passed && levelPassed;
+    }
+    return passed;
+}
+
+}
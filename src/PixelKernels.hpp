@@ -0,0 +1,84 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace webcam {
+
+/// \brief Instruction set level the pixel kernels are compiled for, each includes the ones before.
+enum class CpuLevel {
+    // x86-64 (SSE2) or whatever the compiler targets on other architectures
+    Baseline,
+    // SSE4.2, POPCNT
+    SSE4,
+    // AVX2, FMA, BMI2
+    AVX2,
+    // AVX-512 F, BW and VL
+    AVX512,
+};
+
+/// \brief Tables of a color transform as PixelKernels::lutBGRA reads them, see ColorTransform.
+struct ColorLut {
+    // size^3 entries of B, G, R and an unused value in 1/256 of an 8 bit level, red index running fastest
+    const uint16_t *table;
+    int size;
+    // per channel value the grid index times 512 plus the position in the cell in 1/256
+    const uint16_t *positions;
+    // B, G and R curve applied after the 3D LUT, curveSteps entries per 8 bit level
+    const uint8_t *curves;
+    static constexpr int curveSteps = 16;
+    static constexpr int curveSize = 256 * curveSteps;
+};
+
+/// \brief The project's own per-pixel loops, one variant per CpuLevel.
+///
+/// The loops are plain C++ compiled several times with different target
+/// flags (PixelKernels.inl), so the compiler vectorizes each for its
+/// instruction set. The variant matching the CPU is picked on first use,
+/// setCpuLevel() overrides that. OpenCV and libyuv do their own dispatch,
+/// setCpuLevel() caps libyuv's as well.
+struct PixelKernels {
+    // one row of TemporalDenoiser, see there
+    void (*denoiseGray)(const uint8_t *cur, const uint8_t *prev, uint8_t *out, int pixels, int staticWeight);
+    void (*denoiseBGRA)(const uint8_t *cur, const uint8_t *prev, uint8_t *out, int pixels, int staticWeight);
+    // gray to YUY2 with neutral chroma
+    void (*packGrayYUY2)(const uint8_t *gray, uint8_t *yuy2, int pixels);
+    // unsharp mask from the image and its blur: img + amount * (img - blurred), saturated,
+    // except where they differ by less than threshold; per byte
+    void (*sharpen)(const uint8_t *img, const uint8_t *blurred, uint8_t *out, int bytes, int threshold, int amount);
+    // shading correction in place, gain per pixel in 1/256, saturated; alpha is left alone
+    void (*gainGray)(uint8_t *image, const uint16_t *gain, int pixels);
+    void (*gainBGRA)(uint8_t *image, const uint16_t *gain, int pixels);
+    // 3D LUT with tetrahedral interpolation, then the 1D curves; alpha is copied
+    void (*lutBGRA)(const uint8_t *bgra, uint8_t *out, int pixels, const ColorLut &lut);
+};
+
+/// \brief Kernels of the active level.
+const PixelKernels &pixelKernels();
+
+/// \brief Kernels of a level, which has to be supported.
+const PixelKernels &pixelKernels(CpuLevel level);
+
+/// \brief Highest level the CPU supports that was compiled in.
+CpuLevel detectCpuLevel();
+
+/// \brief Levels that are compiled in and supported by the CPU, ascending.
+std::vector<CpuLevel> supportedCpuLevels();
+
+CpuLevel cpuLevel();
+
+/// \brief Uses the kernels of level from now on, call before any processing starts.
+/// \throws std::invalid_argument if the CPU doesn't support it or it isn't compiled in
+void setCpuLevel(CpuLevel level);
+
+/// \brief "baseline", "sse4", "avx2" or "avx512", case insensitive.
+CpuLevel parseCpuLevel(const std::string &text);
+const char *name(CpuLevel level);
+
+/// \brief Runs every kernel of every supported level on the same random rows (odd lengths
+/// included, so the scalar tails are covered) and compares with the baseline, reporting to out.
+/// \return true if all variants produced identical output
+bool selfTestPixelKernels(std::ostream &out);
+
+}
@@ -0,0 +1,157 @@
+// Body of every PixelKernels variant. Included by one translation unit per
+// CpuLevel, each compiled with its own target flags and defining
+// WEBCAM_KERNEL_LEVEL to name its namespace.
+//
+// Nothing here may call inline functions or templates from headers (std::min,
+// cv::saturate_cast, ...): their out-of-line copies are merged by the linker,
+// which could pick the AVX-512 one for every caller. Everything used lives in
+// the anonymous namespace, so it stays local to the variant.
+#include "PixelKernels.hpp"
+
+#ifndef WEBCAM_KERNEL_LEVEL
+#error "WEBCAM_KERNEL_LEVEL has to name the variant"
+#endif
+
+namespace webcam::WEBCAM_KERNEL_LEVEL {
+
+namespace {
+
+// TemporalDenoiser: weight of the new frame rises by this much per level of luma difference, a
+// difference of about 16 (well above the sensor noise at full gain) takes the new frame as is
+constexpr int motionSlope = 16;
+
+inline int absolute(int value) {
+    return value < 0 ? -value : value;
+}
+
+inline int smaller(int a, int b) {
+    return a < b ? a : b;
+}
+
+inline int larger(int a, int b) {
+    return a > b ? a : b;
+}
+
+// Plain loop over whole pixels without branches, the compiler vectorizes it (-O3)
+template<int Channels>
+void denoiseRow(const uint8_t *__restrict cur, const uint8_t *__restrict prev, uint8_t *__restrict out,
+                int pixels, int staticWeight) {
+    for (int x = 0; x < Channels * pixels; x += Channels)
+    {
+        int difference;
+        if constexpr (Channels == 1)
+        {
+            difference = absolute(cur[x] - prev[x]);
+        }
+        else
+        {
+            const int lumaCur = cur[x] + 2 * cur[x + 1] + cur[x + 2];
+            const int lumaPrev = prev[x] + 2 * prev[x + 1] + prev[x + 2];
+            difference = absolute(lumaCur - lumaPrev) >> 2;
+        }
+        const int weight = smaller(256, staticWeight + difference * motionSlope);
+        for (int channel = 0; channel < Channels; channel++)
+        {
+            const int p = prev[x + channel];
+            out[x + channel] = static_cast<uint8_t>(p + (((cur[x + channel] - p) * weight) >> 8));
+        }
+    }
+}
+
+void denoiseGray(const uint8_t *cur, const uint8_t *prev, uint8_t *out, int pixels, int staticWeight) {
+    denoiseRow<1>(cur, prev, out, pixels, staticWeight);
+}
+
+void denoiseBGRA(const uint8_t *cur, const uint8_t *prev, uint8_t *out, int pixels, int staticWeight) {
+    denoiseRow<4>(cur, prev, out, pixels, staticWeight);
+}
+
+void packGrayYUY2(const uint8_t *__restrict gray, uint8_t *__restrict yuy2, int pixels) {
+    // every second byte is U or V, neutral without color
+    for (int x = 0; x < pixels; x++)
+    {
+        yuy2[2 * x] = gray[x];
+        yuy2[2 * x + 1] = 128;
+    }
+}
+
+void sharpen(const uint8_t *__restrict img, const uint8_t *__restrict blurred, uint8_t *__restrict out,
+             int bytes, int threshold, int amount) {
+    for (int x = 0; x < bytes; x++)
+    {
+        const int difference = img[x] - blurred[x];
+        const int sharpened = img[x] + amount * difference;
+        const int saturated = sharpened < 0 ? 0 : (sharpened > 255 ? 255 : sharpened);
+        out[x] = static_cast<uint8_t>(absolute(difference) < threshold ? img[x] : saturated);
+    }
+}
+
+template<int Channels>
+void gainRow(uint8_t *__restrict image, const uint16_t *__restrict gain, int pixels) {
+    for (int x = 0; x < pixels; x++)
+    {
+        const int g = gain[x];
+        // color channels only, BGRA's alpha stays as it is
+        for (int channel = 0; channel < (Channels == 4 ? 3 : 1); channel++)
+        {
+            const int corrected = (image[Channels * x + channel] * g + 128) >> 8;
+            image[Channels * x + channel] = static_cast<uint8_t>(corrected > 255 ? 255 : corrected);
+        }
+    }
+}
+
+void gainGray(uint8_t *image, const uint16_t *gain, int pixels) {
+    gainRow<1>(image, gain, pixels);
+}
+
+void gainBGRA(uint8_t *image, const uint16_t *gain, int pixels) {
+    gainRow<4>(image, gain, pixels);
+}
+
+// The cell is split into six tetrahedra along its black-white diagonal, the one holding the
+// color is picked by the order of the fractions. The color is the weighted sum of its corners:
+// black, one step along the largest fraction, one along the two largest, and white.
+void lutBGRA(const uint8_t *__restrict bgra, uint8_t *__restrict out, int pixels, const ColorLut &lut) {
+    const uint16_t *__restrict table = lut.table;
+    const uint16_t *__restrict positions = lut.positions;
+    const uint8_t *__restrict curves = lut.curves;
+    const int stepR = 4;
+    const int stepG = 4 * lut.size;
+    const int stepB = 4 * lut.size * lut.size;
+    const int white = stepR + stepG + stepB;
+    for (int x = 0; x < 4 * pixels; x += 4)
+    {
+        const int pb = positions[bgra[x]];
+        const int pg = positions[bgra[x + 1]];
+        const int pr = positions[bgra[x + 2]];
+        const int fb = pb & 511;
+        const int fg = pg & 511;
+        const int fr = pr & 511;
+        const uint16_t *black = table + (pr >> 9) * stepR + (pg >> 9) * stepG + (pb >> 9) * stepB;
+
+        // without branches, the order of the fractions changes from pixel to pixel with noise;
+        // on ties the corner picked doesn't matter as its weight is 0
+        const int largest = larger(fr, larger(fg, fb));
+        const int smallest = smaller(fr, smaller(fg, fb));
+        const int middle = fr + fg + fb - largest - smallest;
+        const int first = fr == largest ? stepR : (fg == largest ? stepG : stepB);
+        const int second = white - (fb == smallest ? stepB : (fg == smallest ? stepG : stepR));
+        const int wBlack = 256 - largest;
+        const int wFirst = largest - middle;
+        const int wSecond = middle - smallest;
+        for (int channel = 0; channel < 3; channel++)
+        {
+            // entries are in 1/256 of a level and the weights add up to 256, the curves have 16 steps per level
+            const int sum = wBlack * black[channel] + wFirst * black[first + channel]
+                            + wSecond * black[second + channel] + smallest * black[white + channel];
+            out[x + channel] = curves[channel * ColorLut::curveSize + (sum >> 12)];
+        }
+        out[x + 3] = bgra[x + 3];
+    }
+}
+
+}
+
+extern const PixelKernels kernels{denoiseGray, denoiseBGRA, packGrayYUY2, sharpen, gainGray, gainBGRA, lutBGRA};
+
+}
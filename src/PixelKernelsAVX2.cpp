@@ -0,0 +1,3 @@
+// PixelKernels for CpuLevel::AVX2, the target flags are set in CMakeLists.txt
+#define WEBCAM_KERNEL_LEVEL avx2
+#include "PixelKernels.inl"
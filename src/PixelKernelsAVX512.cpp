@@ -0,0 +1,3 @@
+// PixelKernels for CpuLevel::AVX512, the target flags are set in CMakeLists.txt
+#define WEBCAM_KERNEL_LEVEL avx512
+#include "PixelKernels.inl"
@@ -0,0 +1,3 @@
+// PixelKernels for CpuLevel::Baseline, the target flags are set in CMakeLists.txt
+#define WEBCAM_KERNEL_LEVEL baseline
+#include "PixelKernels.inl"
@@ -0,0 +1,3 @@
+// PixelKernels for CpuLevel::SSE4, the target flags are set in CMakeLists.txt
+#define WEBCAM_KERNEL_LEVEL sse4
+#include "PixelKernels.inl"
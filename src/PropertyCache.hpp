@@ -0,0 +1,200 @@
+#pragma once
+#include <algorithm>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <mvIMPACT_CPP/mvIMPACT_acquire.h>
+
+namespace webcam::Driver {
+
+class PropertyWriteBatch;
+
+/// \brief Type independent part of a CachedProperty, lets PropertyWriteBatch hold any of them.
+class CachedPropertyBase {
+public:
+    virtual ~CachedPropertyBase() = default;
+
+protected:
+    friend class PropertyWriteBatch;
+    // writes the value queued by PropertyWriteBatch::set, called with the batch lock held
+    virtual void applyPending() = 0;
+    virtual std::string name() const = 0;
+    bool _pending{false};
+};
+
+/// \brief A property that is resolved and validated once.
+///
+/// Validity, write access, the translation dictionary and the limits are read
+/// when the handle is created (or refresh() is called), so checking and writing
+/// a value afterwards costs no allocation and no additional driver calls.
+/// Every write goes to the driver, the same property may also be written by
+/// Camera::applySetting or the driver itself, so the last value written here
+/// says nothing about the current one.
+template<typename _Ty>
+class CachedProperty : public CachedPropertyBase {
+public:
+    using value_type = typename _Ty::value_type;
+
+    explicit CachedProperty(const _Ty &prop) : _prop(prop) {
+        refresh();
+    }
+
+    /// \brief Reads validity, dictionary and limits again, e.g. after a setting changed the limits.
+    void refresh() {
+        _writeable = _prop.isValid() && _prop.isWriteable();
+        _dict.clear();
+        _hasDict = _writeable && _prop.hasDict();
+        if (_hasDict)
+        {
+            _prop.getTranslationDictValues(_dict);
+            std::sort(_dict.begin(), _dict.end());
+        }
+        _hasMin = _writeable && _prop.hasMinValue();
+        _hasMax = _writeable && _prop.hasMaxValue();
+        if (_hasMin)
+        {
+            _min = _prop.getMinValue();
+        }
+        if (_hasMax)
+        {
+            _max = _prop.getMaxValue();
+        }
+    }
+
+    bool isWriteable() const {
+        return _writeable;
+    }
+
+    /// \brief Same check as CameraHelper::supportsValue, against the cached dictionary and limits.
+    bool supportsValue(const value_type &value) const {
+        if (!_writeable)
+        {
+            return false;
+        }
+        if (_hasDict)
+        {
+            return std::binary_search(_dict.begin(), _dict.end(), value);
+        }
+        return !(_hasMin && value < _min) && !(_hasMax && _max < value);
+    }
+
+    /// \brief Clamps a value into the cached limits, for properties without a dictionary.
+    value_type clamp(const value_type &value) const {
+        if (_hasMin && value < _min)
+        {
+            return _min;
+        }
+        if (_hasMax && _max < value)
+        {
+            return _max;
+        }
+        return value;
+    }
+
+    /// \brief Writes the value right away if it is supported.
+    bool write(const value_type &value) {
+        if (!supportsValue(value))
+        {
+            return false;
+        }
+        _prop.write(value);
+        return true;
+    }
+
+    const _Ty &property() const {
+        return _prop;
+    }
+
+private:
+    friend class PropertyWriteBatch;
+
+    _Ty _prop;
+    bool _writeable{false};
+    bool _hasDict{false};
+    std::vector<value_type> _dict;
+    bool _hasMin{false};
+    bool _hasMax{false};
+    value_type _min{};
+    value_type _max{};
+    value_type _pendingValue{};
+
+    void applyPending() override {
+        write(_pendingValue);
+    }
+
+    std::string name() const override {
+        return _prop.name();
+    }
+};
+
+/// \brief Collects property writes from any thread and applies them in one go.
+///
+/// Camera calls apply() from the capture thread between two frames, so a
+/// controller can queue changes at any time without touching the driver from
+/// its own thread. Several writes to the same property before apply() collapse
+/// into the last one.
+class PropertyWriteBatch {
+public:
+    PropertyWriteBatch() {
+        // more properties than we will ever queue at once, no allocation in set() and apply()
+        _dirty.reserve(32);
+        _applying.reserve(32);
+    }
+
+    /// \brief Queues value for prop. Unsupported values are dropped when applied.
+    template<typename _Ty>
+    void set(CachedProperty<_Ty> &prop, const typename CachedProperty<_Ty>::value_type &value) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        prop._pendingValue = value;
+        if (!prop._pending)
+        {
+            prop._pending = true;
+            _dirty.push_back(&prop);
+        }
+    }
+
+    /// \brief Writes everything that was queued since the last call. A write the driver refuses
+    /// (e.g. as binning or the AOI changed the limits) is logged and doesn't stop the others.
+    void apply() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        // off the list before anything is written, a failing write leaves nothing pending
+        _applying.swap(_dirty);
+        _dirty.clear();
+        for (auto *prop : _applying)
+        {
+            prop->_pending = false;
+        }
+        for (auto *prop : _applying)
+        {
+            try
+            {
+                prop->applyPending();
+            }
+            catch (const mvIMPACT::acquire::ImpactAcquireException &e)
+            {
+                std::cout << "Property '" << prop->name() << "' not written (" << e.getErrorCodeAsString() << ")"
+                          << std::endl;
+            }
+        }
+        _applying.clear();
+    }
+
+    /// \brief Drops everything queued, before the queued properties go away.
+    void discard() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto *prop : _dirty)
+        {
+            prop->_pending = false;
+        }
+        _dirty.clear();
+    }
+
+private:
+    std::mutex _mutex;
+    std::vector<CachedPropertyBase *> _dirty;
+    // the properties apply() is writing
+    std::vector<CachedPropertyBase *> _applying;
+};
+
+}
@@ -0,0 +1,147 @@
+#include "QualityController.hpp"
+#include "Metrics.hpp"
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <strings.h>
+
+namespace webcam {
+
+namespace {
+
+constexpr QualityStep allSteps[] = {QualityStep::Sharpening, QualityStep::Detection, QualityStep::Demosaic,
+                                    QualityStep::FrameRate};
+
+std::string trim(const std::string &text) {
+    const auto begin = text.find_first_not_of(" \t");
+    if (begin == std::string::npos)
+    {
+        return "";
+    }
+    return text.substr(begin, text.find_last_not_of(" \t") - begin + 1);
+}
+
+}
+
+QualityController::QualityController(std::vector<QualityStep> steps, double framesPerSecond,
+                                     const std::string &metricsName)
+    : _steps(std::move(steps)), _name(metricsName), _frameInterval_s(1 / framesPerSecond),
+      _loadBefore(_steps.size() + 1, 0), _saving(_steps.size() + 1, 0),
+      _levelMetric(Metrics::global().gauge(metricsName + ".quality.level")),
+      _loadMetric(Metrics::global().gauge(metricsName + ".quality.load")),
+      _changesMetric(Metrics::global().counter(metricsName + ".quality.changes")) {
+    if (framesPerSecond <= 0)
+    {
+        throw std::invalid_argument("frame rate has to be positive");
+    }
+}
+
+bool QualityController::update(std::chrono::duration<double> processing) {
+    const double interval_s = reduced(QualityStep::FrameRate) ? 2 * _frameInterval_s : _frameInterval_s;
+    _load += smoothing * (processing.count() / interval_s - _load);
+    _loadMetric = _load;
+    if (_steps.empty())
+    {
+        return false;
+    }
+    if (_framesSinceChange < settleFrames)
+    {
+        if (++_framesSinceChange == settleFrames && _measureSaving)
+        {
+            _measureSaving = false;
+            _saving[_level] = std::max(0.0, _loadBefore[_level] - _load);
+        }
+        return false;
+    }
+
+    const int previous = _level;
+    if (_load > degradeLoad && _level < static_cast<int>(_steps.size()))
+    {
+        _level++;
+        _loadBefore[_level] = _load;
+        _measureSaving = true;
+    }
+    else if (_level > 0 && _load + _saving[_level] < restoreLoad)
+    {
+        if (++_restoreCount >= restoreFrames)
+        {
+            // the saving of the level below stays as measured when it was entered
+            _level--;
+        }
+    }
+    else
+    {
+        _restoreCount = 0;
+    }
+    if (_level == previous)
+    {
+        return false;
+    }
+
+    _framesSinceChange = 0;
+    _restoreCount = 0;
+    _levelMetric = _level;
+    _changesMetric++;
+    std::cout << _name << ": processing load " << static_cast<int>(100 * _load) << "%, quality level " << _level;
+    if (_level > 0)
+    {
+        std::cout << " (without";
+        for (int i = 0; i < _level; i++)
+        {
+            std::cout << (i == 0 ? " " : ", ") << name(_steps[i]);
+        }
+        std::cout << ")";
+    }
+    std::cout << std::endl;
+    return true;
+}
+
+bool QualityController::reduced(QualityStep step) const {
+    const auto end = _steps.begin() + _level;
+    return std::find(_steps.begin(), end, step) != end;
+}
+
+std::vector<QualityStep> QualityController::parseSteps(const std::string &text) {
+    std::vector<QualityStep> steps;
+    if (strcasecmp(trim(text).c_str(), "off") == 0)
+    {
+        return steps;
+    }
+    std::istringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        item = trim(item);
+        const auto step = std::find_if(std::begin(allSteps), std::end(allSteps), [&item](QualityStep candidate) {
+            return strcasecmp(item.c_str(), name(candidate)) == 0;
+        });
+        if (step == std::end(allSteps) || std::find(steps.begin(), steps.end(), *step) != steps.end())
+        {
+            throw std::invalid_argument("has to be off or a list of sharpening, detection, demosaic, frameRate");
+        }
+        steps.push_back(*step);
+    }
+    if (steps.empty())
+    {
+        throw std::invalid_argument("has to be off or a list of sharpening, detection, demosaic, frameRate");
+    }
+    return steps;
+}
+
+const char *QualityController::name(QualityStep step) {
+    switch (step)
+    {
+        case QualityStep::Sharpening:
+            return "sharpening";
+        case QualityStep::Detection:
+            return "detection";
+        case QualityStep::Demosaic:
+            return "demosaic";
+        case QualityStep::FrameRate:
+            return "frameRate";
+    }
+    return "";
+}
+
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace webcam {
+
+/// \brief Work that is given up when frames take longer than the camera delivers them.
+enum class QualityStep {
+    // the face window is published unsharpened
+    Sharpening,
+    // faces are searched a third as often
+    Detection,
+    // the driver demosaics with linear interpolation instead of the configured bayerConversionMode
+    Demosaic,
+    // only every second frame is processed, the outputs repeat the last one
+    FrameRate,
+};
+
+/// \brief Sheds processing steps while frames don't fit the frame interval and restores them once they do.
+///
+/// The processing time of every frame is compared with the interval the camera
+/// delivers frames at (twice that while FrameRate is given up) and smoothed.
+/// Above degradeLoad the next step is given up, each level keeps the steps of the
+/// levels below it. When a step was given up the load it saved is measured, the
+/// step comes back once the load plus that saving stayed below restoreLoad for
+/// restoreFrames, so a restored step doesn't push the load right back up.
+class QualityController {
+public:
+    /// \param steps in the order they are given up, empty turns the controller off
+    /// \param metricsName prefix of the <name>.quality.* metrics
+    QualityController(std::vector<QualityStep> steps, double framesPerSecond, const std::string &metricsName);
+
+    /// \brief Takes the processing time of a frame.
+    /// \return true if the level changed
+    bool update(std::chrono::duration<double> processing);
+
+    /// \brief Number of steps given up, 0 is full quality.
+    int level() const {
+        return _level;
+    }
+
+    /// \brief True if step is given up at the current level.
+    bool reduced(QualityStep step) const;
+
+    /// \brief A comma separated list of sharpening, detection, demosaic and frameRate
+    /// (case insensitive) or "off".
+    static std::vector<QualityStep> parseSteps(const std::string &text);
+    static const char *name(QualityStep step);
+
+private:
+    // smoothed processing time per frame interval
+    static constexpr double degradeLoad{0.85};
+    static constexpr double restoreLoad{0.7};
+    static constexpr int restoreFrames{90};
+    // frames after a change before the load is judged again, the smoothing needs them to catch up
+    static constexpr int settleFrames{20};
+    static constexpr double smoothing{0.1};
+
+    const std::vector<QualityStep> _steps;
+    const std::string _name;
+    const double _frameInterval_s;
+    int _level{0};
+    double _load{0};
+    int _framesSinceChange{0};
+    int _restoreCount{0};
+    // load just before each level was entered and what entering it saved, measured after settleFrames
+    std::vector<double> _loadBefore;
+    std::vector<double> _saving;
+    bool _measureSaving{false};
+
+    std::atomic<double> &_levelMetric;
+    std::atomic<double> &_loadMetric;
+    std::atomic<unsigned long> &_changesMetric;
+};
+
+}
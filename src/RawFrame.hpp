@@ -0,0 +1,61 @@
+#pragma once
+#include <stdexcept>
+#include <string>
+
+namespace webcam {
+
+/// \brief Pixel layout the camera delivers, chosen once when the camera is opened.
+enum class SensorFormat {
+    // 1 byte per pixel
+    Mono8,
+    // 2 bytes per pixel, Y0 U Y1 V
+    YUV422,
+    // 3 bytes per pixel, R G B in memory (mvIMPACT's idpfBGR888Packed)
+    BGR888,
+};
+
+/// \brief A frame as delivered by the camera, the data is not owned.
+struct RawFrame {
+    int width{0};
+    int height{0};
+    // interleaved bytes per pixel, see SensorFormat
+    int channelCount{0};
+    void *data{nullptr};
+
+    // position of the image on the sensor in full resolution sensor pixels, non zero when an AOI is set
+    int offsetX{0};
+    int offsetY{0};
+    // sensor pixels that were combined into one image pixel
+    int binningX{1};
+    int binningY{1};
+};
+
+inline int bytesPerPixel(SensorFormat format) {
+    switch (format)
+    {
+        case SensorFormat::Mono8:
+            return 1;
+        case SensorFormat::YUV422:
+            return 2;
+        case SensorFormat::BGR888:
+            return 3;
+    }
+    throw std::invalid_argument("unknown sensor format");
+}
+
+/// \brief Format of frames with RawFrame::channelCount bytes per pixel, e.g. from a recording.
+inline SensorFormat sensorFormatFor(int bytesPerPixel) {
+    switch (bytesPerPixel)
+    {
+        case 1:
+            return SensorFormat::Mono8;
+        case 2:
+            return SensorFormat::YUV422;
+        case 3:
+            return SensorFormat::BGR888;
+        default:
+            throw std::invalid_argument("no sensor format with " + std::to_string(bytesPerPixel) + " bytes per pixel");
+    }
+}
+
+}
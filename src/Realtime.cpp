@@ -0,0 +1,283 @@
+#include "Realtime.hpp"
+#include <opencv2/core.hpp>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <pthread.h>
+#include <sched.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+namespace webcam {
+
+namespace {
+
+// default huge page size on x86-64 and arm64
+constexpr size_t hugePageSize = 2 << 20;
+// smaller images aren't worth a huge page
+constexpr size_t hugePageThreshold = 1 << 20;
+constexpr size_t pageSize = 4096;
+
+bool hasCapability(int capability) {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+    {
+        if (line.compare(0, 7, "CapEff:") == 0)
+        {
+            return (std::stoull(line.substr(7), nullptr, 16) >> capability) & 1;
+        }
+    }
+    return false;
+}
+
+// CAP_IPC_LOCK from linux/capability.h
+constexpr int capIpcLock = 14;
+
+/// \brief Allocates large Mats from huge pages, everything else like cv::Mat's own allocator.
+/// Modelled on OpenCV's StdMatAllocator, userdata holds the mapped length of huge page buffers.
+class HugePageAllocator : public cv::MatAllocator {
+public:
+    cv::UMatData *allocate(int dims, const int *sizes, int type, void *data0, size_t *step,
+                           cv::AccessFlag, cv::UMatUsageFlags) const override {
+        size_t total = CV_ELEM_SIZE(type);
+        for (int i = dims - 1; i >= 0; i--)
+        {
+            if (step)
+            {
+                if (data0 && step[i] != CV_AUTOSTEP)
+                {
+                    CV_Assert(total <= step[i]);
+                    total = step[i];
+                }
+                else
+                {
+                    step[i] = total;
+                }
+            }
+            total *= sizes[i];
+        }
+
+        auto *u = new cv::UMatData(this);
+        u->size = total;
+        if (data0)
+        {
+            u->data = u->origdata = static_cast<uchar *>(data0);
+            u->flags |= cv::UMatData::USER_ALLOCATED;
+        }
+        else if (total >= hugePageThreshold)
+        {
+            const size_t length = (total + hugePageSize - 1) / hugePageSize * hugePageSize;
+            u->data = u->origdata = static_cast<uchar *>(mapHugePages(length));
+            u->userdata = reinterpret_cast<void *>(length);
+        }
+        else
+        {
+            u->data = u->origdata = static_cast<uchar *>(cv::fastMalloc(total));
+        }
+        return u;
+    }
+
+    bool allocate(cv::UMatData *u, cv::AccessFlag, cv::UMatUsageFlags) const override {
+        return u != nullptr;
+    }
+
+    void deallocate(cv::UMatData *u) const override {
+        if (!u)
+        {
+            return;
+        }
+        CV_Assert(u->urefcount == 0);
+        CV_Assert(u->refcount == 0);
+        if (!(u->flags & cv::UMatData::USER_ALLOCATED))
+        {
+            if (u->userdata)
+            {
+                munmap(u->origdata, reinterpret_cast<size_t>(u->userdata));
+            }
+            else
+            {
+                cv::fastFree(u->origdata);
+            }
+            u->origdata = nullptr;
+        }
+        delete u;
+    }
+
+private:
+    mutable std::atomic<bool> _reservedMissing{false};
+    mutable std::atomic<bool> _transparentMissing{false};
+
+    /// \brief length bytes of prefaulted memory, aligned to a huge page.
+    void *mapHugePages(size_t length) const {
+        // reserved huge pages, MAP_POPULATE faults them in right away
+        void *data = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+        if (data != MAP_FAILED)
+        {
+            return data;
+        }
+        if (!_reservedMissing.exchange(true))
+        {
+            std::cout << "Warning: no reserved huge pages (vm.nr_hugepages), using transparent huge pages" << std::endl;
+        }
+
+        // map one huge page more and cut it down to an aligned range, so the kernel can back it with huge pages
+        auto *mapped = static_cast<uchar *>(mmap(nullptr, length + hugePageSize, PROT_READ | PROT_WRITE,
+                                                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+        if (mapped == MAP_FAILED)
+        {
+            throw std::bad_alloc();
+        }
+        const auto offset = reinterpret_cast<uintptr_t>(mapped) % hugePageSize;
+        uchar *aligned = mapped + (offset == 0 ? 0 : hugePageSize - offset);
+        if (aligned != mapped)
+        {
+            munmap(mapped, aligned - mapped);
+        }
+        if (aligned + length != mapped + length + hugePageSize)
+        {
+            munmap(aligned + length, mapped + length + hugePageSize - (aligned + length));
+        }
+        if (madvise(aligned, length, MADV_HUGEPAGE) != 0 && !_transparentMissing.exchange(true))
+        {
+            std::cout << "Warning: transparent huge pages not available (" << std::strerror(errno)
+                      << "), frame buffers use normal pages" << std::endl;
+        }
+        // fault in now, not during the first frame
+        for (size_t i = 0; i < length; i += pageSize)
+        {
+            static_cast<volatile uchar *>(aligned)[i] = 0;
+        }
+        return aligned;
+    }
+};
+
+}
+
+ThreadScheduling::Policy ThreadScheduling::parsePolicy(const std::string &text) {
+    if (strcasecmp(text.c_str(), "fifo") == 0)
+    {
+        return Policy::FIFO;
+    }
+    if (strcasecmp(text.c_str(), "rr") == 0)
+    {
+        return Policy::RR;
+    }
+    if (strcasecmp(text.c_str(), "default") == 0)
+    {
+        return Policy::Default;
+    }
+    throw std::invalid_argument("has to be FIFO, RR or Default");
+}
+
+std::vector<int> ThreadScheduling::parseCpus(const std::string &text) {
+    std::vector<int> cpus;
+    std::istringstream stream(text);
+    std::string range;
+    while (std::getline(stream, range, ','))
+    {
+        int first = -1;
+        int last = -1;
+        size_t parsed = 0;
+        try
+        {
+            first = last = std::stoi(range, &parsed);
+            if (parsed < range.size() && range[parsed] == '-')
+            {
+                size_t parsedLast = 0;
+                last = std::stoi(range.substr(parsed + 1), &parsedLast);
+                parsed += 1 + parsedLast;
+            }
+        }
+        catch (const std::exception &)
+        {
+        }
+        if (parsed == 0 || parsed != range.size() || first < 0 || last < first || last >= CPU_SETSIZE)
+        {
+            throw std::invalid_argument("has to be a list of CPUs like 2,3 or 0-3");
+        }
+        for (int cpu = first; cpu <= last; cpu++)
+        {
+            cpus.push_back(cpu);
+        }
+    }
+    if (cpus.empty())
+    {
+        throw std::invalid_argument("has to be a list of CPUs like 2,3 or 0-3");
+    }
+    return cpus;
+}
+
+bool applyScheduling(const ThreadScheduling &scheduling, const std::string &who) {
+    bool applied = true;
+    if (!scheduling.cpus.empty())
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (int cpu : scheduling.cpus)
+        {
+            CPU_SET(cpu, &cpus);
+        }
+        if (const int error = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus); error != 0)
+        {
+            std::cout << "Warning: " << who << " can't be bound to its CPUs: " << std::strerror(error) << std::endl;
+            applied = false;
+        }
+    }
+    if (scheduling.policy != ThreadScheduling::Policy::Default)
+    {
+        const int policy = scheduling.policy == ThreadScheduling::Policy::FIFO ? SCHED_FIFO : SCHED_RR;
+        sched_param param{};
+        param.sched_priority = scheduling.priority;
+        if (const int error = pthread_setschedparam(pthread_self(), policy, &param); error != 0)
+        {
+            std::cout << "Warning: " << who << " keeps the default scheduling, real-time priority "
+                      << scheduling.priority << " failed: " << std::strerror(error);
+            if (error == EPERM)
+            {
+                std::cout << " (needs root, CAP_SYS_NICE or an rtprio limit)";
+            }
+            else if (error == EINVAL)
+            {
+                std::cout << " (priority has to be " << sched_get_priority_min(policy) << " to "
+                          << sched_get_priority_max(policy) << ")";
+            }
+            std::cout << std::endl;
+            applied = false;
+        }
+    }
+    return applied;
+}
+
+bool lockMemory() {
+    // mlockall(MCL_FUTURE) under a finite limit makes allocations fail once the limit is reached
+    rlimit limit{};
+    getrlimit(RLIMIT_MEMLOCK, &limit);
+    if (limit.rlim_cur != RLIM_INFINITY && geteuid() != 0 && !hasCapability(capIpcLock))
+    {
+        std::cout << "Warning: memory not locked, needs root, CAP_IPC_LOCK or ulimit -l unlimited" << std::endl;
+        return false;
+    }
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+    {
+        std::cout << "Warning: memory not locked: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void useHugePageBuffers() {
+    // never destroyed, Mats may be released during static destruction
+    static auto *allocator = new HugePageAllocator();
+    cv::Mat::setDefaultAllocator(allocator);
+}
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <string>
+#include <vector>
+
+namespace webcam {
+
+/// \brief Scheduling policy, real-time priority and CPUs of a thread.
+struct ThreadScheduling {
+    enum class Policy {
+        Default,
+        FIFO,
+        RR,
+    };
+
+    Policy policy{Policy::Default};
+    // 1-99, only for FIFO and RR
+    int priority{0};
+    // CPUs the thread may run on, empty for all
+    std::vector<int> cpus;
+
+    bool isDefault() const {
+        return policy == Policy::Default && cpus.empty();
+    }
+
+    /// \brief "fifo", "rr" or "default", case insensitive.
+    static Policy parsePolicy(const std::string &text);
+    /// \brief A list like "2,3" or "0-3".
+    static std::vector<int> parseCpus(const std::string &text);
+};
+
+/// \brief Applies scheduling to the calling thread. What the process isn't allowed to do
+/// (SCHED_FIFO/RR need root or CAP_SYS_NICE) is skipped with a warning mentioning who.
+/// \return false if something was skipped
+bool applyScheduling(const ThreadScheduling &scheduling, const std::string &who);
+
+/// \brief Locks all current and future memory of the process (mlockall), so frame buffers are
+/// never paged out and new ones are faulted in when they are allocated rather than on first use.
+/// Skipped with a warning without CAP_IPC_LOCK or an unlimited memlock limit, since later
+/// allocations would fail once the limit is reached.
+/// \return false if skipped
+bool lockMemory();
+
+/// \brief From now on OpenCV allocates images of a MiB and more (full frames, the pipeline's
+/// buffers) from huge pages, prefaulted right away. Reserved huge pages (vm.nr_hugepages) are
+/// used if there are any, transparent huge pages otherwise, with a warning if neither is possible.
+void useHugePageBuffers();
+
+}
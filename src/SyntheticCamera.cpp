@@ -0,0 +1,261 @@
+#include "SyntheticCamera.hpp"
+#include <opencv2/imgproc.hpp>
+#include <libyuv.h>
+#include <algorithm>
+#include <stdexcept>
+
+namespace webcam {
+
+cv::Mat renderTestImage(int width, int height, SensorFormat format, unsigned int seed) {
+    // gradient plus noise, enough structure to keep every stage busy
+    cv::Mat gradient(height, width, CV_8UC3);
+    for (int y = 0; y < gradient.rows; y++)
+    {
+        for (int x = 0; x < gradient.cols; x++)
+        {
+            gradient.at<cv::Vec3b>(y, x) = cv::Vec3b(x % 256, y % 256, (x + y) % 256);
+        }
+    }
+    // signed, in 8 bit unsigned the negative half of the noise would end up as 0
+    cv::RNG random(seed);
+    cv::Mat noise(gradient.size(), CV_16SC3);
+    random.fill(noise, cv::RNG::NORMAL, cv::Scalar::all(0), cv::Scalar::all(8));
+    cv::Mat rgb;
+    cv::add(gradient, noise, rgb, cv::noArray(), CV_8U);
+
+    cv::Mat image;
+    switch (format)
+    {
+        case SensorFormat::Mono8:
+            cv::cvtColor(rgb, image, cv::COLOR_RGB2GRAY);
+            break;
+        case SensorFormat::YUV422:
+        {
+            cv::Mat bgra;
+            cv::cvtColor(rgb, bgra, cv::COLOR_RGB2BGRA);
+            image.create(rgb.size(), CV_8UC2);
+            libyuv::ARGBToYUY2(bgra.data, static_cast<int>(bgra.step), image.data, static_cast<int>(image.step),
+                               bgra.cols, bgra.rows);
+            break;
+        }
+        case SensorFormat::BGR888:
+            image = rgb;
+            break;
+    }
+    return image;
+}
+
+SyntheticCamera::SyntheticCamera(const SyntheticCameraConfig &config)
+    : _config(config),
+      _frameInterval(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+              std::chrono::duration<double>(1 / config.framesPerSecond))),
+      _random(config.seed) {
+    if (config.width <= 0 || config.height <= 0 || config.framesPerSecond <= 0 || config.requestCount <= 0)
+    {
+        throw std::invalid_argument("synthetic camera needs a size, a frame rate and requests");
+    }
+    if (config.format == SensorFormat::YUV422 && config.width % 2 != 0)
+    {
+        throw std::invalid_argument("YUV422 needs an even width");
+    }
+    _scene = renderTestImage(config.width, config.height + scrollRows, config.format, config.seed);
+    _slots.resize(config.requestCount);
+    _nextFrame = std::chrono::steady_clock::now() + _frameInterval;
+}
+
+void SyntheticCamera::open() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_open)
+    {
+        return;
+    }
+    _open = true;
+    _silentUntil = {};
+    _nextFrame = std::chrono::steady_clock::now() + _frameInterval;
+    for (auto &slot : _slots)
+    {
+        if (slot.state != RequestState::Locked)
+        {
+            slot.state = RequestState::Free;
+        }
+    }
+    _queued.clear();
+    _finished.clear();
+}
+
+void SyntheticCamera::close() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _open = false;
+    for (auto &slot : _slots)
+    {
+        if (slot.state != RequestState::Locked)
+        {
+            slot.state = RequestState::Free;
+        }
+    }
+    _queued.clear();
+    _finished.clear();
+    _changed.notify_all();
+}
+
+bool SyntheticCamera::isOpen() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _open;
+}
+
+bool SyntheticCamera::queueRequest(int &number) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    // a frame due before this request was queued must not end up in it
+    advance(std::chrono::steady_clock::now());
+    if (!_open)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < _slots.size(); i++)
+    {
+        if (_slots[i].state == RequestState::Free)
+        {
+            _slots[i].state = RequestState::Queued;
+            _queued.push_back(static_cast<int>(i));
+            number = static_cast<int>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SyntheticCamera::waitForRequest(std::chrono::milliseconds timeout, CaptureRequest &request) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (true)
+    {
+        const auto now = std::chrono::steady_clock::now();
+        advance(now);
+        if (!_finished.empty())
+        {
+            break;
+        }
+        if (now >= deadline)
+        {
+            return false;
+        }
+        _changed.wait_until(lock, _open ? std::min(_nextFrame, deadline) : deadline);
+    }
+
+    const int number = _finished.front();
+    _finished.pop_front();
+    Slot &slot = _slots[number];
+    slot.state = RequestState::Locked;
+    request.number = number;
+    request.ok = slot.ok;
+    request.result = slot.ok ? "OK" : "synthetic request error";
+    request.frame = RawFrame();
+    if (slot.ok)
+    {
+        request.frame.width = _config.width;
+        request.frame.height = _config.height;
+        request.frame.channelCount = bytesPerPixel(_config.format);
+        request.frame.data = _scene.ptr(slot.scroll);
+    }
+    request.timestamp_us = slot.timestamp_us;
+    request.expose_us = 1e6 / _config.framesPerSecond / 2;
+    request.gain_dB = 0;
+    return true;
+}
+
+void SyntheticCamera::unlockRequest(int number) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (number >= 0 && number < static_cast<int>(_slots.size()) && _slots[number].state == RequestState::Locked)
+    {
+        _slots[number].state = RequestState::Free;
+    }
+}
+
+void SyntheticCamera::resetRequests() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto &slot : _slots)
+    {
+        if (slot.state != RequestState::Locked)
+        {
+            slot.state = RequestState::Free;
+        }
+    }
+    _queued.clear();
+    _finished.clear();
+}
+
+SyntheticCamera::Statistics SyntheticCamera::statistics() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _statistics;
+}
+
+void SyntheticCamera::advance(std::chrono::steady_clock::time_point now) {
+    while (_open && _nextFrame <= now)
+    {
+        if (_queued.empty())
+        {
+            // nothing to fill, skip to the first frame after now at once
+            const auto missed = (now - _nextFrame) / _frameInterval + 1;
+            _statistics.lost += missed;
+            _frameCount += missed;
+            _nextFrame += missed * _frameInterval;
+            break;
+        }
+        finishFrame(_nextFrame);
+        _nextFrame += _frameInterval;
+    }
+}
+
+void SyntheticCamera::finishFrame(std::chrono::steady_clock::time_point time) {
+    _frameCount++;
+    if (time < _silentUntil)
+    {
+        return;
+    }
+    if (_uniform(_random) < _config.deviceLossRate)
+    {
+        loseDevice();
+        return;
+    }
+    if (_uniform(_random) < _config.timeoutRate)
+    {
+        _statistics.timeouts++;
+        _silentUntil = time + _config.timeoutDuration;
+        return;
+    }
+
+    const int number = _queued.front();
+    _queued.pop_front();
+    Slot &slot = _slots[number];
+    slot.state = RequestState::Finished;
+    slot.ok = _uniform(_random) >= _config.badRequestRate;
+    slot.timestamp_us = std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count();
+    slot.scroll = static_cast<int>(_frameCount % scrollRows);
+    if (slot.ok)
+    {
+        _statistics.delivered++;
+    }
+    else
+    {
+        _statistics.badRequests++;
+    }
+    _finished.push_back(number);
+    _changed.notify_all();
+}
+
+void SyntheticCamera::loseDevice() {
+    _statistics.deviceLosses++;
+    _open = false;
+    for (auto &slot : _slots)
+    {
+        if (slot.state != RequestState::Locked)
+        {
+            slot.state = RequestState::Free;
+        }
+    }
+    _queued.clear();
+    _finished.clear();
+    _changed.notify_all();
+}
+
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <vector>
+#include <opencv2/core.hpp>
+#include "CaptureDevice.hpp"
+
+namespace webcam {
+
+/// \brief What a SyntheticCamera delivers and how it misbehaves.
+struct SyntheticCameraConfig {
+    int width{752};
+    int height{480};
+    SensorFormat format{SensorFormat::BGR888};
+    double framesPerSecond{30};
+    // size of the request pool, as the driver's requestCount
+    int requestCount{4};
+
+    // per frame probabilities of a fault
+    // the device delivers nothing for timeoutDuration, the capture thread's waits time out
+    double timeoutRate{0};
+    std::chrono::milliseconds timeoutDuration{1000};
+    // the request comes back with an error instead of an image
+    double badRequestRate{0};
+    // the device is gone: queued requests are dropped and nothing works until it is opened again
+    double deviceLossRate{0};
+    // of the faults and the image noise
+    unsigned int seed{0};
+};
+
+/// \brief A gradient with noise drawn from seed, as the camera delivers it in format. What a SyntheticCamera
+/// shows, and the reference frame of the benchmarks.
+cv::Mat renderTestImage(int width, int height, SensorFormat format, unsigned int seed = 0);
+
+/// \brief A CaptureDevice without hardware, for load and fault tests.
+///
+/// Behaves like the driver's request pool: the sensor finishes a frame every
+/// 1/framesPerSecond into the oldest queued request, a frame without a queued
+/// request is lost, waitForRequest() blocks until a frame is due. The image is
+/// a noisy gradient that scrolls by a row per frame, so change detection sees
+/// motion. The requests point into one prerendered image, filling a request
+/// costs nothing.
+class SyntheticCamera : public CaptureDevice {
+public:
+    explicit SyntheticCamera(const SyntheticCameraConfig &config);
+
+    SyntheticCamera(const SyntheticCamera &) = delete;
+    SyntheticCamera(SyntheticCamera &&) = delete;
+    SyntheticCamera &operator=(const SyntheticCamera &) = delete;
+    SyntheticCamera &operator=(SyntheticCamera &&) = delete;
+
+    /// \brief Also after a device loss, all requests are free afterwards.
+    void open() override;
+    void close() override;
+    bool isOpen() const override;
+
+    bool queueRequest(int &number) override;
+    bool waitForRequest(std::chrono::milliseconds timeout, CaptureRequest &request) override;
+    void unlockRequest(int number) override;
+    void resetRequests() override;
+
+    struct Statistics {
+        unsigned long delivered{0};
+        // frames the sensor finished while no request was queued
+        unsigned long lost{0};
+        unsigned long badRequests{0};
+        unsigned long timeouts{0};
+        unsigned long deviceLosses{0};
+    };
+
+    Statistics statistics() const;
+
+private:
+    enum class RequestState {
+        Free, Queued, Finished, Locked
+    };
+    struct Slot {
+        RequestState state{RequestState::Free};
+        bool ok{false};
+        int64_t timestamp_us{0};
+        int scroll{0};
+    };
+
+    // rows the image scrolls before it repeats
+    static constexpr int scrollRows{64};
+
+    const SyntheticCameraConfig _config;
+    const std::chrono::steady_clock::duration _frameInterval;
+    // height + scrollRows rows, the frames are windows into it
+    cv::Mat _scene;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _changed;
+    std::vector<Slot> _slots;
+    std::deque<int> _queued;
+    std::deque<int> _finished;
+    bool _open{true};
+    std::chrono::steady_clock::time_point _nextFrame;
+    std::chrono::steady_clock::time_point _silentUntil;
+    int64_t _frameCount{0};
+    std::mt19937 _random;
+    std::uniform_real_distribution<double> _uniform{0, 1};
+    Statistics _statistics;
+
+    // lets the sensor finish every frame that is due by now
+    void advance(std::chrono::steady_clock::time_point now);
+    void finishFrame(std::chrono::steady_clock::time_point time);
+    void loseDevice();
+};
+
+}
@@ -0,0 +1,59 @@
+#include "TemporalDenoiser.hpp"
+#include "PixelKernels.hpp"
+#include <stdexcept>
+
+using namespace std::chrono;
+
+namespace webcam {
+
+TemporalDenoiser::TemporalDenoiser(cv::Size size, int strength, int type) : _size(size), _type(type) {
+    if (type != CV_8UC4 && type != CV_8UC1)
+    {
+        throw std::invalid_argument("denoiser needs BGRA or gray frames");
+    }
+    for (auto &frame : _ring)
+    {
+        frame.create(size, type);
+    }
+    setStrength(strength);
+}
+
+void TemporalDenoiser::setStrength(int strength) {
+    if (strength < 0 || strength > 95)
+    {
+        throw std::invalid_argument("denoise strength has to be 0 to 95");
+    }
+    _strength = strength;
+    _staticWeight = 256 * (100 - strength) / 100;
+}
+
+cv::Mat &TemporalDenoiser::beginFrame() {
+    const auto now = steady_clock::now();
+    _filterFrame = _hasHistory && _strength > 0 && now - _lastFrame < maxFrameGap;
+    _lastFrame = now;
+    _hasHistory = true;
+    _current = (_current + 1) % ringSize;
+    return _ring[_current];
+}
+
+void TemporalDenoiser::filterRows(const cv::Mat &src, int rowBegin, int rowEnd) {
+    if (src.size() != _size || src.type() != _type)
+    {
+        throw std::invalid_argument("illegal denoiser input");
+    }
+    cv::Mat &out = _ring[_current];
+    if (!_filterFrame)
+    {
+        src.rowRange(rowBegin, rowEnd).copyTo(out.rowRange(rowBegin, rowEnd));
+        return;
+    }
+    const cv::Mat &prev = _ring[(_current + ringSize - 1) % ringSize];
+    const PixelKernels &kernels = pixelKernels();
+    const auto denoiseRow = _type == CV_8UC1 ? kernels.denoiseGray : kernels.denoiseBGRA;
+    for (int row = rowBegin; row < rowEnd; row++)
+    {
+        denoiseRow(src.ptr(row), prev.ptr(row), out.ptr(row), _size.width, _staticWeight);
+    }
+}
+
+}
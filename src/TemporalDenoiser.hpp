@@ -0,0 +1,57 @@
+#pragma once
+#include <opencv2/core.hpp>
+#include <array>
+#include <chrono>
+
+namespace webcam {
+
+/// \brief Motion adaptive recursive noise filter for BGRA or gray frames.
+///
+/// Every output pixel is a blend of the new frame and the previous output.
+/// Where the luma barely changed the previous output keeps most of the
+/// weight, where it changed by more than the noise would explain the new
+/// frame wins, so moving edges don't smear. History is a ring of frames
+/// allocated once, a frame is filtered into the next slot of the ring.
+class TemporalDenoiser {
+public:
+    /// \param strength percentage (0-95) of the previous output kept for static pixels, 0 turns the filter off
+    /// \param type CV_8UC4 (BGRA) or CV_8UC1
+    TemporalDenoiser(cv::Size size, int strength, int type = CV_8UC4);
+
+    void setStrength(int strength);
+
+    int strength() const {
+        return _strength;
+    }
+
+    /// \brief Starts a frame, returns the ring slot filterRows() writes to.
+    /// Without a recent previous frame (first frame, after a pause) the frame is passed through unfiltered.
+    cv::Mat &beginFrame();
+
+    /// \brief Filters the rows [rowBegin, rowEnd) of src, which has the size and type given at construction, into
+    /// the slot returned by beginFrame(). Disjoint row ranges can be processed in parallel.
+    void filterRows(const cv::Mat &src, int rowBegin, int rowEnd);
+
+    /// \brief Drops the history, e.g. when the input changed.
+    void reset() {
+        _hasHistory = false;
+    }
+
+private:
+    static constexpr size_t ringSize{2};
+    // longer gaps (camera was idle) make the history useless
+    static constexpr std::chrono::milliseconds maxFrameGap{500};
+
+    const cv::Size _size;
+    const int _type;
+    int _strength{0};
+    // weight of the new frame for static pixels, 256 = 1
+    int _staticWeight{256};
+    std::array<cv::Mat, ringSize> _ring;
+    size_t _current{0};
+    bool _hasHistory{false};
+    bool _filterFrame{false};
+    std::chrono::steady_clock::time_point _lastFrame;
+};
+
+}
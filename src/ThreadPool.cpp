@@ -0,0 +1,245 @@
+#include "ThreadPool.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <opencv2/core.hpp>
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && (CV_VERSION_MINOR > 5 || (CV_VERSION_MINOR == 5 && CV_VERSION_REVISION >= 2)))
+#include <opencv2/core/parallel/parallel_backend.hpp>
+#define WEBCAM_OPENCV_BACKEND
+#endif
+
+namespace webcam {
+
+namespace {
+
+// set while the thread runs a band, OpenCV calls from there don't split up any further
+thread_local bool insideBand = false;
+// 1..n on the workers, 0 on the callers
+thread_local int workerIndex = 0;
+// the pool OpenCV's loops run on, see runOpenCvLoops()
+std::atomic<ThreadPool *> openCvPool{nullptr};
+
+class BandScope {
+public:
+    BandScope() : _outer(insideBand) {
+        insideBand = true;
+    }
+
+    ~BandScope() {
+        insideBand = _outer;
+    }
+
+private:
+    const bool _outer;
+};
+
+#ifdef WEBCAM_OPENCV_BACKEND
+class OpenCvLoops final : public cv::parallel::ParallelForAPI {
+public:
+    void parallel_for(int tasks, FN_parallel_for_body_cb_t body, void *data) override {
+        ThreadPool *pool = openCvPool;
+        if (pool == nullptr || insideBand)
+        {
+            body(0, tasks, data);
+            return;
+        }
+        // OpenCV may ask for one task per row, a few bands per thread are enough to balance
+        const int grain = std::max(1, tasks / (4 * static_cast<int>(pool->threadCount())));
+        pool->parallelFor(0, tasks, grain, [body, data](int begin, int end) {
+            body(begin, end, data);
+        }, "opencv");
+    }
+
+    int getThreadNum() const override {
+        return workerIndex;
+    }
+
+    int getNumThreads() const override {
+        ThreadPool *pool = openCvPool;
+        return pool == nullptr ? 1 : static_cast<int>(pool->threadCount());
+    }
+
+    // the pool's size is fixed
+    int setNumThreads(int) override {
+        return getNumThreads();
+    }
+
+    const char *getName() const override {
+        return "webcam thread pool";
+    }
+};
+#endif
+
+}
+
+ThreadPool::ThreadPool(unsigned int threadCount, const ThreadScheduling &scheduling) : _scheduling(scheduling) {
+    if (threadCount == 0)
+    {
+        throw std::invalid_argument("thread pool needs at least one thread");
+    }
+
+    for (unsigned int i = 0; i < threadCount; i++)
+    {
+        _queues.emplace_back(std::make_unique<Queue>());
+    }
+    for (unsigned int i = 1; i < threadCount; i++)
+    {
+        _workers.emplace_back(&ThreadPool::workerMain, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    ThreadPool *self = this;
+    openCvPool.compare_exchange_strong(self, nullptr);
+    {
+        std::lock_guard<std::mutex> lock(_wakeMutex);
+        _threadShouldRun = false;
+    }
+    _wake.notify_all();
+    for (auto &worker : _workers)
+    {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallelFor(int begin, int end, int grain, const std::function<void(int, int)> &body,
+                             const char *traceName) {
+    if (end <= begin)
+    {
+        return;
+    }
+    grain = std::max(grain, 1);
+    const int bandCount = (end - begin + grain - 1) / grain;
+    if (_workers.empty() || bandCount == 1)
+    {
+        BandScope band;
+        TRACE_SCOPE(traceName, begin);
+        body(begin, end);
+        return;
+    }
+
+    Job job;
+    job.traceName = traceName;
+    job.remaining = bandCount;
+
+    // deal the bands out round robin, starting at a different queue each time so
+    // concurrent callers don't all pile onto the same worker
+    size_t queue = _nextQueue++ % _queues.size();
+    for (int bandBegin = begin; bandBegin < end; bandBegin += grain)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_queues[queue]->mutex);
+            _queues[queue]->tasks.push_back(Task{&body, bandBegin, std::min(bandBegin + grain, end), &job});
+        }
+        queue = (queue + 1) % _queues.size();
+    }
+    {
+        std::lock_guard<std::mutex> lock(_wakeMutex);
+        _queuedTasks += bandCount;
+    }
+    _wake.notify_all();
+
+    // help out until nothing is left to steal, then wait for the bands still running
+    while (job.remaining > 0 && runTask(0)) {}
+    std::unique_lock<std::mutex> lock(job.mutex);
+    job.done.wait(lock, [&job] { return job.remaining == 0; });
+    if (job.error)
+    {
+        std::rethrow_exception(job.error);
+    }
+}
+
+bool ThreadPool::runTask(size_t ownQueue) {
+    Task task{};
+    bool found = false;
+    for (size_t i = 0; i < _queues.size() && !found; i++)
+    {
+        Queue &queue = *_queues[(ownQueue + i) % _queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty())
+        {
+            continue;
+        }
+        // own work from the front, stolen work from the back
+        if (i == 0)
+        {
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+        }
+        else
+        {
+            task = queue.tasks.back();
+            queue.tasks.pop_back();
+        }
+        found = true;
+    }
+    if (!found)
+    {
+        return false;
+    }
+    _queuedTasks--;
+
+    // caught here, on a worker it would terminate the program and on a caller it would unwind past
+    // the job while other threads still work on it; parallelFor() rethrows it
+    std::exception_ptr error;
+    try
+    {
+        BandScope band;
+        TRACE_SCOPE(task.job->traceName, task.begin);
+        (*task.body)(task.begin, task.end);
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+
+    // decrement under the lock, the job lives on the caller's stack and is gone as soon as it sees zero
+    std::lock_guard<std::mutex> lock(task.job->mutex);
+    if (error && !task.job->error)
+    {
+        task.job->error = error;
+    }
+    if (--task.job->remaining == 0)
+    {
+        task.job->done.notify_all();
+    }
+    return true;
+}
+
+void ThreadPool::runOpenCvLoops() {
+#ifdef WEBCAM_OPENCV_BACKEND
+    openCvPool = this;
+    static const bool installed = [] {
+        cv::parallel::setParallelForBackend(std::make_shared<OpenCvLoops>());
+        return true;
+    }();
+    (void) installed;
+#else
+    cv::setNumThreads(1);
+#endif
+}
+
+void ThreadPool::workerMain(size_t ownQueue) {
+    workerIndex = static_cast<int>(ownQueue);
+    TRACE_THREAD_NAME("pool worker " + std::to_string(ownQueue));
+    if (!_scheduling.isDefault())
+    {
+        applyScheduling(_scheduling, "pool worker " + std::to_string(ownQueue));
+    }
+    while (true)
+    {
+        if (runTask(ownQueue))
+        {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(_wakeMutex);
+        _wake.wait(lock, [this] { return _queuedTasks > 0 || !_threadShouldRun; });
+        if (!_threadShouldRun)
+        {
+            return;
+        }
+    }
+}
+
+}
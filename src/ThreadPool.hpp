@@ -0,0 +1,85 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Realtime.hpp"
+
+namespace webcam {
+
+/// \brief Small work-stealing pool for splitting a single frame into row bands.
+///
+/// Every worker owns a queue, idle workers steal from the back of the others.
+/// The thread calling parallelFor() works on the bands as well, so a pool of
+/// N threads starts N-1 workers. Several cameras may share one pool.
+/// The workers apply scheduling when they start, the callers keep their own.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned int threadCount, const ThreadScheduling &scheduling = {});
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool(ThreadPool &&) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    ThreadPool &operator=(ThreadPool &&) = delete;
+
+    /// \brief Calls body(bandBegin, bandEnd) for consecutive bands of at most grain
+    /// elements covering [begin, end) and returns once all of them are done.
+    /// Every band shows up in the trace (see Trace) as traceName, a string literal.
+    /// If a band throws, the other bands still run and the first exception is rethrown here.
+    void parallelFor(int begin, int end, int grain, const std::function<void(int, int)> &body,
+                     const char *traceName = "band");
+
+    /// \brief Runs OpenCV's own parallel loops, e.g. in CascadeClassifier::detectMultiScale, on this pool
+    /// instead of a second set of threads, until the pool is destroyed. OpenCV calls made inside a band
+    /// stay single threaded. Before OpenCV 4.5.2 OpenCV can only be made single threaded.
+    void runOpenCvLoops();
+
+    /// \brief Number of threads working on a parallelFor(), including the caller.
+    unsigned int threadCount() const {
+        return static_cast<unsigned int>(_workers.size()) + 1;
+    }
+
+private:
+    struct Job {
+        const char *traceName;
+        std::atomic<int> remaining{0};
+        std::mutex mutex;
+        std::condition_variable done;
+        // the first exception a band threw, with mutex held
+        std::exception_ptr error;
+    };
+
+    struct Task {
+        const std::function<void(int, int)> *body;
+        int begin;
+        int end;
+        Job *job;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    // queue 0 is shared by the callers, 1..n belong to the workers
+    std::vector<std::unique_ptr<Queue>> _queues;
+    std::vector<std::thread> _workers;
+    std::atomic<unsigned int> _nextQueue{0};
+
+    std::mutex _wakeMutex;
+    std::condition_variable _wake;
+    std::atomic<int> _queuedTasks{0};
+    bool _threadShouldRun{true};
+    const ThreadScheduling _scheduling;
+
+    bool runTask(size_t ownQueue);
+    void workerMain(size_t ownQueue);
+};
+
+}
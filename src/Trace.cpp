@@ -0,0 +1,166 @@
+#include "Trace.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace webcam {
+
+namespace {
+
+struct Event {
+    const char *name;
+    int64_t start_ns;
+    // negative for instant events
+    int64_t duration_ns;
+    int64_t argument;
+};
+
+struct ThreadBuffer {
+    // ~0.6 MB per thread, a few seconds of a busy thread
+    static constexpr uint64_t capacity{16384};
+
+    std::array<Event, capacity> events;
+    // events ever written, only the owning thread increments it
+    std::atomic<uint64_t> written{0};
+    int id{0};
+    std::string name;
+    bool named{false};
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    int64_t start_ns{Trace::now()};
+};
+
+Registry &registry() {
+    static Registry instance;
+    return instance;
+}
+
+ThreadBuffer &threadBuffer() {
+    // shared with the registry, a dump after the thread ended still sees its events
+    thread_local std::shared_ptr<ThreadBuffer> buffer = [] {
+        auto created = std::make_shared<ThreadBuffer>();
+        Registry &r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        created->id = static_cast<int>(r.buffers.size()) + 1;
+        r.buffers.push_back(created);
+        return created;
+    }();
+    return *buffer;
+}
+
+void record(const Event &event) {
+    ThreadBuffer &buffer = threadBuffer();
+    const uint64_t index = buffer.written.load(std::memory_order_relaxed);
+    buffer.events[index % ThreadBuffer::capacity] = event;
+    buffer.written.store(index + 1, std::memory_order_release);
+}
+
+void writeEscaped(std::ostream &stream, const std::string &text) {
+    for (const char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            stream << '\\';
+        }
+        stream << c;
+    }
+}
+
+}
+
+void Trace::span(const char *name, int64_t start_ns, int64_t end_ns, int64_t argument) {
+    record(Event{name, start_ns, end_ns - start_ns, argument});
+}
+
+void Trace::instant(const char *name, int64_t argument) {
+    record(Event{name, now(), -1, argument});
+}
+
+bool Trace::threadNamed() {
+    return threadBuffer().named;
+}
+
+void Trace::setThreadName(const std::string &name) {
+    ThreadBuffer &buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    buffer.name = name;
+    buffer.named = true;
+}
+
+void Trace::dump(std::ostream &stream) {
+    Registry &r = registry();
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    {
+        std::lock_guard<std::mutex> lock(r.mutex);
+        buffers = r.buffers;
+    }
+
+    // microseconds with ns resolution
+    stream << std::fixed << std::setprecision(3);
+    stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    std::vector<Event> events;
+    for (const auto &buffer : buffers)
+    {
+        {
+            std::lock_guard<std::mutex> lock(r.mutex);
+            stream << (first ? "" : ",\n") << R"({"name":"thread_name","ph":"M","pid":1,"tid":)" << buffer->id
+                   << R"(,"args":{"name":")";
+            writeEscaped(stream, buffer->named ? buffer->name : "thread " + std::to_string(buffer->id));
+            stream << "\"}}";
+            first = false;
+        }
+
+        // copy without stopping the thread, then drop whatever it may have overwritten meanwhile
+        const uint64_t before = buffer->written.load(std::memory_order_acquire);
+        const uint64_t begin = before > ThreadBuffer::capacity ? before - ThreadBuffer::capacity : 0;
+        events.clear();
+        for (uint64_t i = begin; i < before; i++)
+        {
+            events.push_back(buffer->events[i % ThreadBuffer::capacity]);
+        }
+        const uint64_t after = buffer->written.load(std::memory_order_acquire);
+        const uint64_t firstValid = after + 1 > ThreadBuffer::capacity ? after + 1 - ThreadBuffer::capacity : 0;
+
+        for (uint64_t i = std::max(begin, firstValid); i < before; i++)
+        {
+            const Event &event = events[i - begin];
+            stream << ",\n{\"name\":\"" << event.name << "\",\"pid\":1,\"tid\":" << buffer->id
+                   << ",\"ts\":" << static_cast<double>(event.start_ns - r.start_ns) / 1000.0;
+            if (event.duration_ns >= 0)
+            {
+                stream << ",\"ph\":\"X\",\"dur\":" << static_cast<double>(event.duration_ns) / 1000.0;
+            }
+            else
+            {
+                stream << R"(,"ph":"i","s":"t")";
+            }
+            if (event.argument != noArgument)
+            {
+                stream << ",\"args\":{\"id\":" << event.argument << "}";
+            }
+            stream << "}";
+        }
+    }
+    stream << "\n]}\n";
+}
+
+bool Trace::dump(const std::string &file) {
+    std::ofstream stream(file);
+    if (!stream)
+    {
+        return false;
+    }
+    dump(stream);
+    return static_cast<bool>(stream);
+}
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace webcam {
+
+/// \brief Records what every thread was doing when, for chrome://tracing or ui.perfetto.dev.
+///
+/// Every thread writes to its own ring buffer without locking; when a ring is
+/// full the oldest events are overwritten, so a dump shows the last few
+/// seconds. Use the TRACE_* macros, they compile to nothing unless the build
+/// has WEBCAM_TRACING set (CMake option of the same name).
+/// Event names have to be string literals, only the pointer is stored.
+class Trace {
+public:
+    static int64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /// \brief A finished span of work on the calling thread.
+    static void span(const char *name, int64_t start_ns, int64_t end_ns, int64_t argument = noArgument);
+    /// \brief A point in time on the calling thread, e.g. a request changing hands.
+    static void instant(const char *name, int64_t argument = noArgument);
+
+    static bool threadNamed();
+    /// \brief Name the calling thread is shown with.
+    static void setThreadName(const std::string &name);
+
+    /// \brief Writes everything that is still buffered as Chrome trace JSON, threads keep recording meanwhile.
+    static void dump(std::ostream &stream);
+    /// \return false if the file can't be written
+    static bool dump(const std::string &file);
+
+    static constexpr int64_t noArgument{-1};
+
+    class Scope {
+    public:
+        explicit Scope(const char *name, int64_t argument = noArgument)
+            : _name(name), _argument(argument), _start(now()) {
+        }
+
+        ~Scope() {
+            span(_name, _start, now(), _argument);
+        }
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        const char *_name;
+        int64_t _argument;
+        int64_t _start;
+    };
+};
+
+}
+
+#ifdef WEBCAM_TRACING
+#define WEBCAM_TRACE_CONCAT_(a, b) a##b
+#define WEBCAM_TRACE_CONCAT(a, b) WEBCAM_TRACE_CONCAT_(a, b)
+/// Span from here to the end of the enclosing block, TRACE_SCOPE(name [, argument])
+#define TRACE_SCOPE(...) ::webcam::Trace::Scope WEBCAM_TRACE_CONCAT(traceScope, __LINE__)(__VA_ARGS__)
+/// TRACE_INSTANT(name [, argument])
+#define TRACE_INSTANT(...) ::webcam::Trace::instant(__VA_ARGS__)
+/// Names the calling thread the first time it gets here, name is only evaluated then
+#define TRACE_THREAD_NAME(name) \
+    do { if (!::webcam::Trace::threadNamed()) ::webcam::Trace::setThreadName(name); } while (false)
+#else
+#define TRACE_SCOPE(...) ((void)0)
+#define TRACE_INSTANT(...) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#endif
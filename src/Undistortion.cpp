@@ -1,48 +1,299 @@
 #include "Undistortion.hpp"
+#include "PixelKernels.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
 
 namespace webcam {
 
+namespace {
+
 // Values obtained from running an non-opensourced calibration
 // script for the lens I'm currently using
 // If these parameter do not match your lense by chance (which they probably wont)
 // just comment out any undistortion stuff
-Undistortion::Undistortion() :
-    _rawInstrinsicMatrix{{
-                             425.399269, 0.000000, 381.599384,
-                             0.000000, 425.446103, 231.300097,
-                             0.000000, 0.000000, 1.000000
-                         }},
-    _rawRectificationMatrix{{
-                                1, 0, 0,
-                                0, 1, 0,
-                                0, 0, 1
-                            }},
-    _rawProjectionMatrix{{
-                             325.399269, 0.000000, 381.599384, 0.000000,
-                             0.000000, 325.446103, 231.300097, 0.000000,
-                             0.000000, 0.000000, 1.000000, 0.000000
-                         }},
-    _rawDistortionMatrix{{
-                             -0.269296, 0.055, -0.000566, 0.001512, 0.000000
-                         }},
-
-    _intrinsicMatrix(3, 3, CV_64F, reinterpret_cast<void *>(_rawInstrinsicMatrix.data())),
-    _rectificationMatrix(3, 3, CV_64F, reinterpret_cast<void *>(_rawRectificationMatrix.data())),
-    _projectionMatrix(3, 4, CV_64F, reinterpret_cast<void *>(_rawProjectionMatrix.data())),
-    _distortionMatrix(1, 5, CV_64F, reinterpret_cast<void *>(_rawDistortionMatrix.data())) {
-    assert(_rawInstrinsicMatrix.size() == 3 * 3);
-    assert(_rawRectificationMatrix.size() == 3 * 3);
-    assert(_rawProjectionMatrix.size() == 3 * 4);
-    assert(_rawDistortionMatrix.size() == 1 * 5);
-
-    cv::initUndistortRectifyMap(_intrinsicMatrix, _distortionMatrix, _rectificationMatrix, _projectionMatrix,
-                                cv::Size(cameraWidth, cameraHeight), CV_32FC1, _undistortionMap1, _undistortionMap2);
-
-}
-void Undistortion::undistortImage(cv::Mat &_src, cv::Mat &_dst) const {
-    cv::UMat src = _src.getUMat(cv::ACCESS_READ);
-    cv::UMat dst = _dst.getUMat(cv::ACCESS_WRITE);
-
-    cv::remap(src, dst, _undistortionMap1, _undistortionMap2, cv::INTER_LINEAR);
+void computeMaps(cv::Mat &map1, cv::Mat &map2) {
+    std::array<double,9> rawInstrinsicMatrix{{
+                                                 425.399269, 0.000000, 381.599384,
+                                                 0.000000, 425.446103, 231.300097,
+                                                 0.000000, 0.000000, 1.000000
+                                             }};
+    std::array<double,9> rawRectificationMatrix{{
+                                                    1, 0, 0,
+                                                    0, 1, 0,
+                                                    0, 0, 1
+                                                }};
+    std::array<double,12> rawProjectionMatrix{{
+                                                  325.399269, 0.000000, 381.599384, 0.000000,
+                                                  0.000000, 325.446103, 231.300097, 0.000000,
+                                                  0.000000, 0.000000, 1.000000, 0.000000
+                                              }};
+    // plumb_bob distortion
+    std::array<double,5> rawDistortionMatrix{{
+                                                 -0.269296, 0.055, -0.000566, 0.001512, 0.000000
+                                             }};
+
+    const cv::Mat intrinsicMatrix(3, 3, CV_64F, rawInstrinsicMatrix.data());
+    const cv::Mat rectificationMatrix(3, 3, CV_64F, rawRectificationMatrix.data());
+    const cv::Mat projectionMatrix(3, 4, CV_64F, rawProjectionMatrix.data());
+    const cv::Mat distortionMatrix(1, 5, CV_64F, rawDistortionMatrix.data());
+
+    cv::initUndistortRectifyMap(intrinsicMatrix, distortionMatrix, rectificationMatrix, projectionMatrix,
+                                cv::Size(Undistortion::cameraWidth, Undistortion::cameraHeight), CV_32FC1,
+                                map1, map2);
+}
+
+}
+
+std::shared_future<std::shared_ptr<const Undistortion::SensorMaps>> Undistortion::sensorMaps() {
+    static std::mutex mutex;
+    static std::shared_future<std::shared_ptr<const SensorMaps>> maps;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!maps.valid())
+    {
+        maps = std::async(std::launch::async, [] {
+            auto computed = std::make_shared<SensorMaps>();
+            computeMaps(computed->map1, computed->map2);
+            return std::shared_ptr<const SensorMaps>(std::move(computed));
+        }).share();
+    }
+    return maps;
+}
+
+void Undistortion::prepare() {
+    sensorMaps();
+}
+
+Undistortion::Undistortion() : _sensorMaps(sensorMaps().get()) {
+}
+
+void Undistortion::setShading(const cv::Mat &sensorGain) {
+    if (!sensorGain.empty() && (sensorGain.size() != cv::Size(cameraWidth, cameraHeight) || sensorGain.type() != CV_32F))
+    {
+        throw std::invalid_argument("shading gain has to be CV_32F of the sensor size");
+    }
+    _sensorGain = sensorGain;
+    _regionGain.release();
+    _gainGrid.release();
+    _windowGain.release();
+    // makes the next setLayout() and setWindow() compute the gains
+    _outputRegion = cv::Rect();
+    _windowSize = cv::Size();
+}
+
+cv::Mat Undistortion::shadingFromFlatField(const cv::Mat &flatField) {
+    cv::Mat luma;
+    if (flatField.channels() == 1)
+    {
+        flatField.convertTo(luma, CV_32F);
+    }
+    else
+    {
+        cv::Mat gray;
+        cv::cvtColor(flatField, gray, flatField.channels() == 4 ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGR2GRAY);
+        gray.convertTo(luma, CV_32F);
+    }
+    cv::resize(luma, luma, cv::Size(cameraWidth, cameraHeight), 0, 0, cv::INTER_AREA);
+    // shading changes slowly over the sensor, the blur removes the noise and any texture of the target
+    cv::GaussianBlur(luma, luma, cv::Size(), 8);
+    double brightest;
+    cv::minMaxLoc(luma, nullptr, &brightest);
+    if (brightest <= 0)
+    {
+        throw std::runtime_error("flat field is black");
+    }
+    cv::Mat gain;
+    cv::divide(brightest, cv::max(luma, brightest / maxShadingGain), gain);
+    return gain;
+}
+
+cv::Mat Undistortion::loadShading(const std::string &flatFieldFile) {
+    const cv::Mat flatField = cv::imread(flatFieldFile, cv::IMREAD_UNCHANGED);
+    if (flatField.empty())
+    {
+        throw std::runtime_error("Can't read flat field " + flatFieldFile);
+    }
+    return shadingFromFlatField(flatField);
+}
+
+cv::Rect Undistortion::sourceRegion(const cv::Rect &outputRegion) const {
+    double minX, maxX, minY, maxY;
+    cv::minMaxLoc(_sensorMaps->map1(outputRegion), &minX, &maxX);
+    cv::minMaxLoc(_sensorMaps->map2(outputRegion), &minY, &maxY);
+
+    // one extra pixel on the far side for the bilinear interpolation
+    const int x = static_cast<int>(std::floor(minX));
+    const int y = static_cast<int>(std::floor(minY));
+    const cv::Rect region(x, y, static_cast<int>(std::ceil(maxX)) - x + 2, static_cast<int>(std::ceil(maxY)) - y + 2);
+    return region & cv::Rect(0, 0, cameraWidth, cameraHeight);
+}
+
+void Undistortion::setLayout(const cv::Rect &outputRegion, const cv::Point &sourceOffset, int binningX, int binningY) {
+    if (outputRegion == _outputRegion && sourceOffset == _sourceOffset && binningX == _binningX && binningY == _binningY)
+    {
+        return;
+    }
+
+    // full resolution sensor coordinates to pixel coordinates of the (binned) AOI image,
+    // a binned pixel i is centered on sensor pixel binning*i + (binning-1)/2
+    cv::Mat map1, map2;
+    _sensorMaps->map1(outputRegion).convertTo(map1, CV_32F, 1.0 / binningX, (0.5 - sourceOffset.x) / binningX - 0.5);
+    _sensorMaps->map2(outputRegion).convertTo(map2, CV_32F, 1.0 / binningY, (0.5 - sourceOffset.y) / binningY - 0.5);
+    cv::convertMaps(map1, map2, _regionMap1, _regionMap2, CV_16SC2);
+    if (!_sensorGain.empty())
+    {
+        // the gain of the sensor pixel each output pixel is read from, independent of AOI and binning
+        cv::Mat regionGain;
+        cv::remap(_sensorGain, regionGain, _sensorMaps->map1(outputRegion), _sensorMaps->map2(outputRegion),
+                  cv::INTER_LINEAR, cv::BORDER_REPLICATE);
+        regionGain.convertTo(_regionGain, CV_16U, 256);
+    }
+
+    // grid for the windows, the last row and column may lie a bit beyond the region
+    const int gridCols = (outputRegion.width + gridStep - 1) / gridStep + 1;
+    const int gridRows = (outputRegion.height + gridStep - 1) / gridStep + 1;
+    _grid.create(gridRows, gridCols, CV_32FC2);
+    if (!_sensorGain.empty())
+    {
+        _gainGrid.create(gridRows, gridCols, CV_32F);
+    }
+    for (int gy = 0; gy < gridRows; gy++)
+    {
+        const int y = std::min(outputRegion.y + gy * gridStep, cameraHeight - 1);
+        auto *gridRow = _grid.ptr<cv::Vec2f>(gy);
+        for (int gx = 0; gx < gridCols; gx++)
+        {
+            const int x = std::min(outputRegion.x + gx * gridStep, cameraWidth - 1);
+            const float sensorX = _sensorMaps->map1.at<float>(y, x);
+            const float sensorY = _sensorMaps->map2.at<float>(y, x);
+            gridRow[gx][0] = static_cast<float>((sensorX + 0.5 - sourceOffset.x) / binningX - 0.5);
+            gridRow[gx][1] = static_cast<float>((sensorY + 0.5 - sourceOffset.y) / binningY - 0.5);
+            if (!_sensorGain.empty())
+            {
+                // nearest sensor pixel, the gain hardly changes from one to the next
+                _gainGrid.at<float>(gy, gx) = _sensorGain.at<float>(
+                        std::clamp(static_cast<int>(std::lround(sensorY)), 0, cameraHeight - 1),
+                        std::clamp(static_cast<int>(std::lround(sensorX)), 0, cameraWidth - 1));
+            }
+        }
+    }
+    _windowSize = cv::Size();
+
+    _outputRegion = outputRegion;
+    _sourceOffset = sourceOffset;
+    _binningX = binningX;
+    _binningY = binningY;
+}
+
+void Undistortion::setWindow(const cv::Rect &window, const cv::Size &size) {
+    if (window == _window && size == _windowSize)
+    {
+        return;
+    }
+
+    // same sampling as cv::resize: output pixel centers spread evenly over the window
+    const double scaleX = static_cast<double>(window.width) / size.width;
+    const double scaleY = static_cast<double>(window.height) / size.height;
+    const auto gridPosition = [](double pixel, int gridSize, int &index, float &fraction) {
+        const double position = std::clamp(pixel / gridStep, 0.0, gridSize - 1.0);
+        index = std::min(static_cast<int>(position), gridSize - 2);
+        fraction = static_cast<float>(position - index);
+    };
+    std::vector<int> columns(size.width);
+    std::vector<float> columnFractions(size.width);
+    for (int x = 0; x < size.width; x++)
+    {
+        gridPosition(window.x + (x + 0.5) * scaleX - 0.5, _grid.cols, columns[x], columnFractions[x]);
+    }
+
+    cv::Mat map(size, CV_32FC2);
+    const bool shading = !_gainGrid.empty();
+    if (shading)
+    {
+        _windowGain.create(size, CV_16U);
+    }
+    for (int y = 0; y < size.height; y++)
+    {
+        int row;
+        float fy;
+        gridPosition(window.y + (y + 0.5) * scaleY - 0.5, _grid.rows, row, fy);
+        const auto *top = _grid.ptr<cv::Vec2f>(row);
+        const auto *bottom = _grid.ptr<cv::Vec2f>(row + 1);
+        auto *mapRow = map.ptr<cv::Vec2f>(y);
+        for (int x = 0; x < size.width; x++)
+        {
+            const int column = columns[x];
+            const float fx = columnFractions[x];
+            for (int c = 0; c < 2; c++)
+            {
+                const float upper = top[column][c] + (top[column + 1][c] - top[column][c]) * fx;
+                const float lower = bottom[column][c] + (bottom[column + 1][c] - bottom[column][c]) * fx;
+                mapRow[x][c] = upper + (lower - upper) * fy;
+            }
+        }
+        if (shading)
+        {
+            const float *gainTop = _gainGrid.ptr<float>(row);
+            const float *gainBottom = _gainGrid.ptr<float>(row + 1);
+            auto *gainRow = _windowGain.ptr<uint16_t>(y);
+            for (int x = 0; x < size.width; x++)
+            {
+                const int column = columns[x];
+                const float fx = columnFractions[x];
+                const float upper = gainTop[column] + (gainTop[column + 1] - gainTop[column]) * fx;
+                const float lower = gainBottom[column] + (gainBottom[column + 1] - gainBottom[column]) * fx;
+                gainRow[x] = static_cast<uint16_t>(std::lround(256 * (upper + (lower - upper) * fy)));
+            }
+        }
+    }
+    cv::convertMaps(map, cv::Mat(), _windowMap1, _windowMap2, CV_16SC2);
+
+    _window = window;
+    _windowSize = size;
+}
+
+void Undistortion::undistortWindow(const cv::Mat &_src, cv::Mat &_dst, int rowBegin, int rowEnd) const {
+    if (!_windowGain.empty())
+    {
+        remapShaded(_src, _dst, _windowMap1, _windowMap2, _windowGain, rowBegin, rowEnd);
+        return;
+    }
+    cv::Mat dst = _dst.rowRange(rowBegin, rowEnd);
+    cv::remap(_src, dst, _windowMap1.rowRange(rowBegin, rowEnd), _windowMap2.rowRange(rowBegin, rowEnd),
+              cv::INTER_LINEAR);
+}
+
+void Undistortion::undistortImage(const cv::Mat &_src, cv::Mat &_dst, int rowBegin, int rowEnd) const {
+    if (!_regionGain.empty())
+    {
+        remapShaded(_src, _dst, _regionMap1, _regionMap2, _regionGain, rowBegin, rowEnd);
+        return;
+    }
+    cv::Mat dst = _dst.rowRange(rowBegin, rowEnd);
+    cv::remap(_src, dst, _regionMap1.rowRange(rowBegin, rowEnd), _regionMap2.rowRange(rowBegin, rowEnd),
+              cv::INTER_LINEAR);
+}
+
+void Undistortion::remapShaded(const cv::Mat &src, cv::Mat &dst, const cv::Mat &map1, const cv::Mat &map2,
+                               const cv::Mat &gain, int rowBegin, int rowEnd) const {
+    if (src.type() != CV_8UC4 && src.type() != CV_8UC1)
+    {
+        throw std::invalid_argument("shading correction needs BGRA or gray frames");
+    }
+    const PixelKernels &kernels = pixelKernels();
+    const auto gainRow = src.type() == CV_8UC4 ? kernels.gainBGRA : kernels.gainGray;
+    for (int begin = rowBegin; begin < rowEnd; begin += shadingRows)
+    {
+        const int end = std::min(begin + shadingRows, rowEnd);
+        cv::Mat rows = dst.rowRange(begin, end);
+        cv::remap(src, rows, map1.rowRange(begin, end), map2.rowRange(begin, end), cv::INTER_LINEAR);
+        for (int row = begin; row < end; row++)
+        {
+            gainRow(dst.ptr(row), gain.ptr<uint16_t>(row), dst.cols);
+        }
+    }
 }
 }
\ No newline at end of file
@@ -1,31 +1,107 @@
 #pragma once
 #include <opencv2/opencv.hpp>
-#include <array>
+#include <future>
+#include <memory>
+#include <string>
 
 namespace webcam {
 
+/// \brief Undistorts frames of the lens the calibration below was made for.
+///
+/// The maps for the full sensor are the same for every camera, they are computed once per
+/// process in the background; constructing an Undistortion waits for them.
+///
+/// Optionally it corrects the lens shading (vignetting) on the way, with a gain per sensor
+/// pixel. The gain is applied to each few rows right after they were remapped, while they
+/// are still in cache, so it costs no extra pass over the frame.
 class Undistortion {
 public:
     Undistortion();
 
-    void undistortImage(cv::Mat& _src, cv::Mat& _dst) const;
+    /// \brief Starts computing the sensor maps, call early during startup (e.g. before opening the devices).
+    static void prepare();
+
+    /// \brief Gain per sensor pixel (full resolution, CV_32F) that undistortImage() and undistortWindow()
+    /// apply, e.g. from shadingFromFlatField(). Empty turns the correction off.
+    void setShading(const cv::Mat& sensorGain);
+
+    /// \brief Gain that evens out a picture of a uniformly lit, white target taken through the lens:
+    /// the brightest part stays as it is, the rest is raised to it, by at most maxShadingGain.
+    /// The picture may be color and of any size, it is scaled to the sensor.
+    static cv::Mat shadingFromFlatField(const cv::Mat& flatField);
+
+    /// \brief shadingFromFlatField() of an image file.
+    /// \throws std::runtime_error if the file can't be read
+    static cv::Mat loadShading(const std::string& flatFieldFile);
+
+    /// \brief Gain undistortImage() applies per output pixel, CV_16U in 1/256, empty without shading correction.
+    const cv::Mat& regionGain() const {
+        return _regionGain;
+    }
+
+    /// \brief Sensor area (full resolution pixels) that is needed to fill outputRegion of the undistorted image.
+    cv::Rect sourceRegion(const cv::Rect& outputRegion) const;
+
+    /// \brief Sets up undistortImage() to produce outputRegion of the undistorted image from an image
+    /// taken with the sensor AOI starting at sourceOffset and the given binning. Cheap if nothing changed.
+    void setLayout(const cv::Rect& outputRegion, const cv::Point& sourceOffset, int binningX, int binningY);
+
+    /// \brief Undistorts the rows [rowBegin, rowEnd) of _dst, _dst has to be allocated with the size of
+    /// the output region already. Disjoint row ranges can be processed in parallel.
+    void undistortImage(const cv::Mat& _src, cv::Mat& _dst, int rowBegin, int rowEnd) const;
+
+    /// \brief Sets up undistortWindow() to produce window (in coordinates of the output region of
+    /// setLayout()) scaled to size, after setLayout(). Cheap if nothing changed.
+    ///
+    /// The source coordinates are interpolated bilinearly from a grid of gridStep pixels taken from the
+    /// sensor maps, a small fraction of a pixel off for this lens. Nothing is computed for the rest of
+    /// the output region.
+    void setWindow(const cv::Rect& window, const cv::Size& size);
+
+    /// \brief Like undistortImage() for the window set with setWindow(), _dst has to have its size already.
+    void undistortWindow(const cv::Mat& _src, cv::Mat& _dst, int rowBegin, int rowEnd) const;
 
     static constexpr int cameraWidth = 752;
     static constexpr int cameraHeight = 480;
+    // output region pixels between two points of the grid setWindow() interpolates from
+    static constexpr int gridStep = 16;
+    static constexpr double maxShadingGain = 4;
 private:
-    std::array<double,9> _rawInstrinsicMatrix;
-    std::array<double,9> _rawRectificationMatrix;
-    std::array<double,12> _rawProjectionMatrix;
-    // plumb_bob distortion
-    std::array<double,5> _rawDistortionMatrix;
-
-    cv::Mat _intrinsicMatrix;
-    cv::Mat _rectificationMatrix;
-    cv::Mat _projectionMatrix;
-    cv::Mat _distortionMatrix;
-
-    cv::Mat _undistortionMap1;
-    cv::Mat _undistortionMap2;
+    // rows remapped at once before their gain is applied, small enough to stay in the L1 cache
+    static constexpr int shadingRows = 4;
+
+    // full sensor, full resolution, shared read only
+    struct SensorMaps {
+        cv::Mat map1;
+        cv::Mat map2;
+    };
+    static std::shared_future<std::shared_ptr<const SensorMaps>> sensorMaps();
+    std::shared_ptr<const SensorMaps> _sensorMaps;
+
+    // current layout, fixed point maps for the output region only
+    cv::Rect _outputRegion;
+    cv::Point _sourceOffset;
+    int _binningX{0};
+    int _binningY{0};
+    cv::Mat _regionMap1;
+    cv::Mat _regionMap2;
+
+    // CV_32F per sensor pixel, empty without shading correction
+    cv::Mat _sensorGain;
+    // CV_16U in 1/256 (see PixelKernels::gainBGRA), empty without shading correction
+    cv::Mat _regionGain;
+    cv::Mat _gainGrid;
+    cv::Mat _windowGain;
+    void remapShaded(const cv::Mat& src, cv::Mat& dst, const cv::Mat& map1, const cv::Mat& map2,
+                     const cv::Mat& gain, int rowBegin, int rowEnd) const;
+
+    // source pixel per grid point of the output region, CV_32FC2
+    cv::Mat _grid;
+    // current window, fixed point maps like the region maps
+    cv::Rect _window;
+    cv::Size _windowSize;
+    cv::Mat _windowMap1;
+    cv::Mat _windowMap2;
 
 };
 
@@ -1,165 +1,152 @@
 #include "Webcam.hpp"
-#include <stdexcept>
-#include <unistd.h>
-#include <sys/ioctl.h>
-#include <array>
-#include <cstring>
-#include <opencv2/opencv.hpp>
-#include <libyuv.h>
-#include <sstream>
+#include <algorithm>
+#include <chrono>
 
 namespace webcam {
 
-Webcam::Webcam(const std::string &device, unsigned int frameWidth, unsigned int frameHeight)
-    : _frameWidth(frameWidth), _frameHeight(frameHeight), _dev_fd(device, O_RDWR), _lastFrame(steady_clock::now()),
-                                                                                              lastFaceDetectionResult(0,0) {
-    if (frameHeight == 0 || frameWidth == 0)
+Webcam::Webcam(SensorFormat sensorFormat, const std::vector<OutputConfig> &outputs, ThreadPool &threadPool,
+               int bandRows)
+    : _pipeline(FramePipeline::create(sensorFormat, outputs, threadPool, bandRows)), _wanted(outputs.size(), true) {
+    for (const auto &config : outputs)
     {
-        throw std::runtime_error("Illegal frame heigh/width");
+        auto newOutput = std::make_unique<Output>(config);
+        Output &output = *newOutput;
+        {
+            // the sinks created so far may already report
+            std::lock_guard<std::mutex> lock(_listenerMutex);
+            _outputs.push_back(std::move(newOutput));
+        }
+        if (config.format == PixelFormat::MJPEG)
+        {
+            output.jpegEncoder = std::make_unique<JpegEncoderPool>(
+                config, [&output](const uint8_t *data, size_t size) { output.sink.submit(data, size); });
+        }
+        output.sink.setConsumerListener([this, &output](bool active) { consumerChanged(output, active); });
     }
+}
 
-
-    /*v4l2_capability vid_caps;
-    if (ioctl(_dev_fd.get(), VIDIOC_QUERYCAP, &vid_caps) < 0) {
-        throw std::runtime_error("cannot query video device");
-    }*/
-
-    _videoFormat.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
-    if (ioctl(_dev_fd.get(), VIDIOC_G_FMT, &_videoFormat) < 0)
-    {
-        throw std::runtime_error("cannot setup video device");
-    }
-    _videoFormat.fmt.pix.width = frameWidth;
-    _videoFormat.fmt.pix.height = frameHeight;
-    _videoFormat.fmt.pix.pixelformat = V4L2_PIX_FMT_YUYV;
-    _videoFormat.fmt.pix.sizeimage = 2 * frameWidth * frameHeight;
-    _videoFormat.fmt.pix.field = V4L2_FIELD_NONE;
-    if (ioctl(_dev_fd.get(), VIDIOC_S_FMT, &_videoFormat) < 0)
+Webcam::~Webcam() {
+    // no sink may report while the outputs are torn down
+    for (auto &output : _outputs)
     {
-        throw std::runtime_error("cannot setup video device");
+        output->sink.setConsumerListener(nullptr);
     }
 }
 
-void Webcam::publish(int imageWidth, int imageHeight, int channelCount, void *rawData) {
-    if (imageWidth != Undistortion::cameraWidth || imageHeight != Undistortion::cameraHeight
-        || (!(channelCount == 1 || channelCount == 3)) || rawData == nullptr)
+bool Webcam::wantsFrame() {
+    if (qualityReduced(QualityStep::FrameRate))
     {
-        throw std::invalid_argument("illegal input");
+        // the sinks repeat the last frame meanwhile
+        _skipNext = !_skipNext;
+        if (_skipNext)
+        {
+            return false;
+        }
     }
-    frameCounter++;
-
-    // incoming picture to RGBA
-    cv::Mat bgraImgDistorted;
-    if (channelCount == 1)
+    bool any = false;
+    for (size_t i = 0; i < _outputs.size(); i++)
     {
-        cv::Mat grayImage(imageHeight, imageWidth, CV_8UC1, rawData);
-        cv::cvtColor(grayImage, bgraImgDistorted, cv::COLOR_GRAY2BGRA);
+        // asks every sink, each one keeps its own schedule
+        _wanted[i] = _outputs[i]->sink.wantsFrame();
+        any = any || _wanted[i];
     }
-    else
+    return any;
+}
+
+void Webcam::setConsumerListener(std::function<void(bool)> listener) {
+    std::lock_guard<std::mutex> lock(_listenerMutex);
+    _consumerListener = std::move(listener);
+    if (_consumerListener)
     {
-        cv::Mat bgrImg(imageHeight, imageWidth, CV_8UC3, rawData);
-        cv::cvtColor(bgrImg, bgraImgDistorted, cv::COLOR_RGB2BGRA);
+        _consumerListener(_reportedActive);
     }
+}
 
-    // undistort
-    cv::Mat bgraImg(bgraImgDistorted.size(), bgraImgDistorted.type());
-    _undistortion.undistortImage(bgraImgDistorted, bgraImg);
-    // undistortion creates black areas in the top and bottom, create region of interest without those
-    cv::Mat bgraROI(bgraImg, cv::Rect(0, 40, _frameWidth, 400));
-
-    // detect face
-    cv::Point faceMiddle = lastFaceDetectionResult;
-    if ((frameCounter % detectionWaitFrames) == 0)
+void Webcam::consumerChanged(Output &output, bool active) {
+    std::lock_guard<std::mutex> lock(_listenerMutex);
+    output.active = active;
+    const bool anyActive = std::any_of(_outputs.begin(), _outputs.end(),
+                                       [](const auto &candidate) { return candidate->active; });
+    if (anyActive != _reportedActive)
     {
-        // save cpu by only detecting so often
-        // but average position every time to have smooth movement
-        const auto faceMiddleDetec = _faceDetector.detectFace(bgraROI);
-        if (faceMiddleDetec.x != 0 && faceMiddleDetec.y != 0)
+        _reportedActive = anyActive;
+        if (_consumerListener)
         {
-            faceMiddle = faceMiddleDetec;
-            if (!firstDetection) {
-                // initial seeding of faceX and Y to avoid slow response of
-                // average filter
-                firstDetection = true;
-                faceX = static_cast<double>(faceMiddle.x);
-                faceY = static_cast<double>(faceMiddle.y);
-            }
+            _consumerListener(anyActive);
         }
     }
-    faceX = avg(faceX, faceMiddle.x);
-    faceY = avg(faceY, faceMiddle.y);
-    lastFaceDetectionResult = faceMiddle;
+}
 
-    const int faceROIStartX = static_cast<int>(std::max(faceX-faceSize/2, 0.0));
-    const int faceROIStartY = static_cast<int>(std::max(faceY-faceSize/2, 0.0));
+cv::Rect Webcam::requiredSensorRegion() const {
+    return _pipeline->requiredSensorRegion();
+}
 
-    int faceWidth = static_cast<int>(faceSize);
-    const int diffW = bgraROI.cols - static_cast<int>(faceROIStartX + faceSize);
-    if (diffW < 0 ) {
-        faceWidth += diffW;
-    }
+bool Webcam::binningIsLossless() const {
+    return _pipeline->binningIsLossless();
+}
 
-    int faceHeight = static_cast<int>(faceSize);
-    const int diffH = bgraROI.rows - static_cast<int>(faceROIStartY + faceSize);
-    if (diffH < 0 ) {
-        faceHeight += diffH;
+void Webcam::publish(const RawFrame &frame) {
+    const auto start = std::chrono::steady_clock::now();
+    _pipeline->process(frame, _wanted);
+    for (size_t i = 0; i < _outputs.size(); i++)
+    {
+        if (!_wanted[i])
+        {
+            continue;
+        }
+        Output &output = *_outputs[i];
+        const cv::Mat &packed = _pipeline->output(i);
+        if (output.jpegEncoder)
+        {
+            // encoded on the pool's threads, it hands the JPEG to the pacer when done
+            output.jpegEncoder->submit(packed);
+        }
+        else
+        {
+            // hand over to the pacer, it writes to the device at the configured rate
+            size_t finalSize = packed.elemSize() * packed.cols * packed.rows;
+            output.sink.submit(packed.data, finalSize);
+        }
     }
+    // without a wantsFrame() call in between the next frame goes to all outputs
+    std::fill(_wanted.begin(), _wanted.end(), true);
+    if (_quality && _quality->update(std::chrono::steady_clock::now() - start))
+    {
+        applyQuality();
+    }
+}
 
-    cv::Mat faceROI(bgraROI, cv::Rect(faceROIStartX, faceROIStartY, faceWidth, faceHeight));
-    cv::Mat& img = faceROI;
-
-    cv::Mat blurred;
-    double sigma = 1, threshold = 2, amount = 1 ;
-    cv::GaussianBlur(img, blurred, cv::Size(), sigma, sigma);
-    cv::Mat lowContrastMask = abs(img - blurred) < threshold;
-    cv::Mat sharpened = img*(1+amount) + blurred*(-amount);
-    img.copyTo(sharpened, lowContrastMask);
-
-    //cv::imshow("aa", bgraROI);
-    //cv::waitKey(0);
-
-    // Resize to fit video target
-    cv::Mat bgraImg_OutputSize;
-    cv::resize(sharpened, bgraImg_OutputSize, cv::Size(_frameWidth, _frameHeight));
-
-    /*auto deltaT{steady_clock::now() - _lastFrame};
-    auto millis{duration_cast<milliseconds>(deltaT).count()};
-    _lastFrame = steady_clock::now();
-    double fps = 1.0 / (static_cast<double>(millis) / 1000.0);
-
-    std::stringstream ss;
-    ss << "FPS: " << std::fixed << std::setprecision(1) << fps;
-    cv::putText(bgraImg_OutputSize,
-                ss.str(),
-                cv::Point(30, 100),
-                cv::HersheyFonts::FONT_HERSHEY_PLAIN,
-                1,
-                cv::Scalar(255, 0, 255, 255));*/
-
-    // convert RGBA to ARGB as I didn't find a RGBA to YUV422 function and openCV doesn't
-    // have an ARGB encoding except when converting from beyer which we don't
-    //cv::Mat argbImg_OutputSize(bgraImg_OutputSize.size(), bgraImg_OutputSize.type());
-    /*libyuv::BGRAToARGB(bgraImg_OutputSize.data, bgraImg_OutputSize.cols * 4, argbImg_OutputSize.data,
-                       argbImg_OutputSize.cols * 4, argbImg_OutputSize.cols, argbImg_OutputSize.rows);*/
+void Webcam::setQualitySteps(const std::vector<QualityStep> &steps, double framesPerSecond) {
+    _quality = std::make_unique<QualityController>(steps, framesPerSecond, _outputs.front()->config.device);
+    applyQuality();
+}
 
-    // even though the method is called ARGB 2 yuv2 it requires the source image to be in BGRA format
-    // or else everything has a blue tinge
-    cv::Mat yuv422Output(bgraImg_OutputSize.size(), CV_8UC2);
-    libyuv::ARGBToYUY2(bgraImg_OutputSize.data, bgraImg_OutputSize.cols * 4,
-                       yuv422Output.data, yuv422Output.cols * 2, bgraImg_OutputSize.cols, bgraImg_OutputSize.rows);
+void Webcam::applyQuality() {
+    _pipeline->setSharpening(!_quality->reduced(QualityStep::Sharpening));
+    _pipeline->setDetectionInterval(_quality->reduced(QualityStep::Detection)
+                                    ? 3 * FramePipeline::detectionWaitFrames : FramePipeline::detectionWaitFrames);
+}
 
-    // write to socket
-    size_t finalSize = yuv422Output.elemSize() * yuv422Output.cols * yuv422Output.rows;
-    if (finalSize != _videoFormat.fmt.pix.sizeimage)
+void Webcam::publishPlaceholder() {
+    // luma of a dark gray, no color
+    constexpr int luma = 40;
+    for (auto &output : _outputs)
     {
-        throw std::runtime_error("yuv array incorrect size");
+        const int width = static_cast<int>(output->config.width);
+        const int height = static_cast<int>(output->config.height);
+        if (output->jpegEncoder)
+        {
+            // planar like FramePipeline::output(), the encoder reads whole MCUs
+            cv::Mat placeholder(2 * height, (width + 15) & ~15, CV_8UC1, cv::Scalar(128));
+            placeholder.rowRange(0, height).setTo(luma);
+            output->jpegEncoder->submit(placeholder);
+        }
+        else
+        {
+            const cv::Mat placeholder(height, width, CV_8UC2, cv::Scalar(luma, 128));
+            output->sink.submit(placeholder.data, placeholder.elemSize() * placeholder.total());
+        }
     }
-    write(_dev_fd.get(), reinterpret_cast<void *>(yuv422Output.data), finalSize);
 }
 
-double Webcam::avg(double value, double newSample) {
-    static constexpr double oneBySampleCnt = 1 / 60.0;
-    return value + ((newSample-value) * oneBySampleCnt);
 }
-
-}
\ No newline at end of file
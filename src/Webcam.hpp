@@ -1,49 +1,114 @@
 #pragma once
 #include <string>
-#include <thread>
-#include "FileHandleWrapper.hpp"
-#include "Undistortion.hpp"
-#include <linux/videodev2.h>
-#include <chrono>
-#include "FaceDetector.hpp"
-
-using namespace std::chrono;
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "LoopbackSink.hpp"
+#include "JpegEncoder.hpp"
+#include "OutputConfig.hpp"
+#include "FramePipeline.hpp"
+#include "QualityController.hpp"
+#include "ThreadPool.hpp"
 
 namespace webcam {
 
+/// \brief The processing pipeline and one loopback device per output.
+///
+/// All outputs are fed from the same processed frame (see FramePipeline),
+/// each one is paced by its own sink.
 class Webcam {
 public:
-    Webcam(const std::string& device, unsigned int frameWidth, unsigned int frameHeight);
+    /// \param sensorFormat format of the frames passed to publish(), picks the FramePipeline variant
+    Webcam(SensorFormat sensorFormat, const std::vector<OutputConfig> &outputs, ThreadPool &threadPool,
+           int bandRows);
+    ~Webcam();
 
     Webcam(const Webcam &) = delete;
     Webcam(Webcam &&) = delete;
     Webcam &operator=(const Webcam &) = delete;
     Webcam &operator=(Webcam &&) = delete;
 
-    void publish(int imageWidth , int imageHeight, int channelCount, void * rawData);
+    /// \brief False if every output pacer would drop a frame captured right now, skip publish() then.
+    /// Otherwise the next publish() only produces the outputs that want the frame.
+    bool wantsFrame();
+
+    void publish(const RawFrame &frame);
+
+    /// \brief Hands a dark gray frame to every output instead of a processed one. The sinks repeat it
+    /// at their rate until the next publish(), so consumers keep getting frames while the camera doesn't deliver.
+    void publishPlaceholder();
+
+    SensorFormat sensorFormat() const {
+        return _pipeline->sensorFormat();
+    }
+
+    /// \brief Sensor area the processing needs, see FramePipeline::requiredSensorRegion.
+    cv::Rect requiredSensorRegion() const;
+
+    /// \brief See FramePipeline::binningIsLossless.
+    bool binningIsLossless() const;
+
+    void setStatisticsEnabled(bool enabled) {
+        _pipeline->setStatisticsEnabled(enabled);
+    }
+
+    void setDenoiseStrength(int strength) {
+        _pipeline->setDenoiseStrength(strength);
+    }
+
+    void setShading(const cv::Mat &sensorGain) {
+        _pipeline->setShading(sensorGain);
+    }
+
+    /// \brief See FramePipeline::setColorTransform, works while publishing.
+    void setColorTransform(std::shared_ptr<const ColorTransform> transform) {
+        _pipeline->setColorTransform(std::move(transform));
+    }
+
+    /// \brief Gives up steps while publish() takes longer than a frame at framesPerSecond, see QualityController.
+    /// Demosaic is up to the caller, see qualityReduced().
+    void setQualitySteps(const std::vector<QualityStep> &steps, double framesPerSecond);
+
+    bool qualityReduced(QualityStep step) const {
+        return _quality && _quality->reduced(step);
+    }
+
+    /// \brief Statistics of the last published frame, see FramePipeline::setStatisticsEnabled.
+    const FaceStatistics &statistics() const {
+        return _pipeline->statistics();
+    }
+
+    /// \brief Called with false when no application reads any of the output devices anymore and with true
+    /// when one attaches.
+    void setConsumerListener(std::function<void(bool)> listener);
 
 private:
-    unsigned int _frameWidth;
-    unsigned int _frameHeight;
-    FileHandleWrapper _dev_fd;
-    v4l2_format _videoFormat;
-    steady_clock::time_point _lastFrame;
-    Undistortion _undistortion;
-    FaceDetector _faceDetector;
-
-    double faceX = 0;
-    double faceY = 0;
-    double faceSize = 250;
-    cv::Point lastFaceDetectionResult;
-    bool firstDetection{false};
-    double avg(double value, double newSample);
-
-    static constexpr int detectionWaitFrames{3};
-    int frameCounter{0};
-
-    //std::thread _writeThread;
-    //bool _threadShouldRun{true};
-    //void threadMain();
+    struct Output {
+        explicit Output(const OutputConfig &config) : config(config), sink(config) {
+        }
+
+        const OutputConfig config;
+        LoopbackSink sink;
+        // MJPEG only, after the sink so its threads are gone before the sink they write to
+        std::unique_ptr<JpegEncoderPool> jpegEncoder;
+        bool active{true};
+    };
+
+    // before the outputs, the sinks' monitor threads report here until they are stopped
+    std::mutex _listenerMutex;
+    std::function<void(bool)> _consumerListener;
+    bool _reportedActive{true};
+    void consumerChanged(Output &output, bool active);
+
+    std::unique_ptr<FramePipeline> _pipeline;
+    std::unique_ptr<QualityController> _quality;
+    // at the reduced frame rate every second frame is skipped
+    bool _skipNext{false};
+    void applyQuality();
+    std::vector<std::unique_ptr<Output>> _outputs;
+    // outputs the next publish() produces
+    std::vector<bool> _wanted;
 };
 
 }
@@ -1,17 +1,211 @@
 #include <iostream>
+#include <string>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
 #include <unistd.h>
+#include <opencv2/core.hpp>
 
 #include "CameraManager.hpp"
+#include "FrameReplay.hpp"
+#include "Metrics.hpp"
+#include "PixelKernels.hpp"
+#include "Realtime.hpp"
+#include "Trace.hpp"
 
 using namespace std;
 
-int main() {
-    webcam::Driver::CameraManager mgr;
+namespace {
 
-  bool shouldRun = true;
-  while (shouldRun) {
+std::atomic<bool> stopRequested{false};
+
+void requestStop(int) {
+  stopRequested = true;
+}
+
+// without SA_RESTART, so a blocking read of stdin returns as well
+void installStopHandler() {
+  struct sigaction action {};
+  action.sa_handler = requestStop;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGINT, &action, nullptr);
+  sigaction(SIGTERM, &action, nullptr);
+}
+
+int positiveNumber(const char *text) {
+  char *end = nullptr;
+  const long number = std::strtol(text, &end, 10);
+  if (*text == '\0' || *end != '\0' || number < 1 || number > 4096) {
+    throw std::invalid_argument(std::string(text) + " has to be a number from 1 to 4096");
+  }
+  return static_cast<int>(number);
+}
+
+void dumpTrace(const std::string &file) {
+  if (file.empty()) {
+    return;
+  }
+  if (webcam::Trace::dump(file)) {
+    std::cout << "Trace written to " << file << std::endl;
+  } else {
+    std::cout << "Cannot write trace to " << file << std::endl;
+  }
+}
+
+// feeds a recording through the same Webcam path the camera uses, no camera needed
+int replay(const std::string &file, bool maxRate, const webcam::ThreadScheduling &processing, unsigned int threads,
+           int bandRows) {
+  webcam::FrameReplay recording(file);
+  if (recording.frameCount() == 0) {
+    std::cout << file << " holds no frames" << std::endl;
+    return 1;
+  }
+  const auto config = webcam::Driver::CameraConfig::load(recording.serial());
+  webcam::ThreadPool threadPool(webcam::Driver::CameraManager::poolSize(threads), processing);
+  threadPool.runOpenCvLoops();
+  // this thread stands in for the capture thread
+  if (!processing.isDefault()) {
+    webcam::applyScheduling(processing, "replay thread");
+  }
+  // recorded in the format the camera delivered, the same pipeline variant processes it
+  const auto sensorFormat = webcam::sensorFormatFor(recording.frame(0).channelCount);
+  webcam::Webcam output(sensorFormat, config.outputs, threadPool, bandRows);
+  // no driver demosaics here
+  config.configure(output, recording.serial(), false);
+
+  std::cout << "Replaying " << recording.frameCount() << " frames of " << recording.serial() << " to";
+  for (const auto &outputConfig : config.outputs) {
+    std::cout << " " << outputConfig.device;
+  }
+  std::cout << (maxRate ? " as fast as possible" : " at the recorded rate") << std::endl;
+  unsigned long published = 0;
+  double total_ms = 0;
+  double worst_ms = 0;
+  recording.play([&](const webcam::RawFrame &frame, const webcam::FrameInfo &) {
+    // at full speed every frame counts for the timing, otherwise behave like the camera
+    if (!maxRate && !output.wantsFrame()) {
+      return;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    output.publish(frame);
+    const double frame_ms =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    published++;
+    total_ms += frame_ms;
+    worst_ms = std::max(worst_ms, frame_ms);
+  }, !maxRate);
+
+  std::cout << "Published " << published << " frames, mean " << (published == 0 ? 0 : total_ms / published)
+            << " ms, worst " << worst_ms << " ms" << std::endl;
+  webcam::Metrics::global().print(std::cout);
+  return 0;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+  // webcam [--trace <file>] [--replay <file> [--max-rate]]
+  //        [--rt-policy fifo|rr] [--rt-priority <1-99>] [--cpus <list>] [--mlock] [--huge-pages]
+  //        [--cpu-level baseline|sse4|avx2|avx512] [--self-test] [--threads <n>] [--band-rows <n>]
+  std::string traceFile;
+  std::string replayFile;
+  bool maxRate = false;
+  // of the processing threads, the capture threads are configured per camera
+  webcam::ThreadScheduling processing;
+  bool mlock = false;
+  bool hugePages = false;
+  bool selfTest = false;
+  // 0 is one thread per core
+  unsigned int threads = 0;
+  int bandRows = webcam::Driver::CameraManager::defaultBandRows;
+  const char *argument = "";
+  try {
+    for (int i = 1; i < argc; i++) {
+      argument = argv[i];
+      if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+        traceFile = argv[++i];
+      } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+        replayFile = argv[++i];
+      } else if (strcmp(argv[i], "--max-rate") == 0) {
+        maxRate = true;
+      } else if (strcmp(argv[i], "--rt-policy") == 0 && i + 1 < argc) {
+        processing.policy = webcam::ThreadScheduling::parsePolicy(argv[++i]);
+      } else if (strcmp(argv[i], "--rt-priority") == 0 && i + 1 < argc) {
+        // out of range priorities are reported when applied
+        processing.priority = std::atoi(argv[++i]);
+        if (processing.policy == webcam::ThreadScheduling::Policy::Default) {
+          processing.policy = webcam::ThreadScheduling::Policy::FIFO;
+        }
+      } else if (strcmp(argv[i], "--cpus") == 0 && i + 1 < argc) {
+        processing.cpus = webcam::ThreadScheduling::parseCpus(argv[++i]);
+      } else if (strcmp(argv[i], "--mlock") == 0) {
+        mlock = true;
+      } else if (strcmp(argv[i], "--huge-pages") == 0) {
+        hugePages = true;
+      } else if (strcmp(argv[i], "--cpu-level") == 0 && i + 1 < argc) {
+        webcam::setCpuLevel(webcam::parseCpuLevel(argv[++i]));
+      } else if (strcmp(argv[i], "--self-test") == 0) {
+        selfTest = true;
+      } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+        threads = static_cast<unsigned int>(positiveNumber(argv[++i]));
+      } else if (strcmp(argv[i], "--band-rows") == 0 && i + 1 < argc) {
+        bandRows = positiveNumber(argv[++i]);
+      } else {
+        throw std::invalid_argument("is not an option");
+      }
+    }
+  } catch (const std::exception &e) {
+    std::cout << argv[0] << ": " << argument << " " << e.what() << std::endl;
+    std::cout << "usage: " << argv[0] << " [--trace <file>] [--replay <file> [--max-rate]]\n"
+              << "       [--rt-policy fifo|rr] [--rt-priority <1-99>] [--cpus <list>] [--mlock] [--huge-pages]\n"
+              << "       [--cpu-level baseline|sse4|avx2|avx512] [--self-test] [--threads <n>] [--band-rows <n>]"
+              << std::endl;
+    return 1;
+  }
+
+  // compares the vectorized pixel kernels with the baseline ones, e.g. on a new machine
+  if (selfTest) {
+    return webcam::selfTestPixelKernels(std::cout) ? 0 : 1;
+  }
+  std::cout << "pixel kernels: " << webcam::name(webcam::cpuLevel()) << std::endl;
+
+  // before anything allocates frame buffers
+  if (hugePages) {
+    webcam::useHugePageBuffers();
+  }
+  if (mlock) {
+    webcam::lockMemory();
+  }
+
+  if (!replayFile.empty()) {
+    const int result = replay(replayFile, maxRate, processing, threads, bandRows);
+    dumpTrace(traceFile);
+    return result;
+  }
+
+  // the trace is written on the way out, Ctrl+C has to end the loops below instead of the process
+  if (!traceFile.empty()) {
+    installStopHandler();
+  }
+
+  webcam::Driver::CameraManager mgr(processing, threads, bandRows);
+
+  // control interface on stdin, see CameraManager::handleCommand
+  std::string line;
+  while (!stopRequested && std::getline(std::cin, line)) {
+    mgr.handleCommand(line);
+  }
+
+  // stdin closed (e.g. started as a service), keep running
+  while (!stopRequested) {
     usleep(10'000);
   }
 
+  dumpTrace(traceFile);
   return 0;
-}
\ No newline at end of file
+}